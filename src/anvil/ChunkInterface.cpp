@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "utility/utility.h"
 #include "anvil/nbtutility.h"
 #include "anvil/ChunkInterface.h"
@@ -88,7 +89,7 @@ ChunkInterface::ChunkInterface(nbt_node* chunk)
     loadHeightMap();
 }
 
-Uint8 ChunkInterface::getHighestSolidBlockY(int x, int z)
+uint8_t ChunkInterface::getHighestSolidBlockY(int x, int z)
 {
     /* To get the highest Y, check the heightmap of that X and Z.
      * The heightMap at that X,Z location will be the lowest location where light
@@ -160,7 +161,7 @@ void ChunkInterface::loadHeightMap()
     }
 }
 
-Uint8 ChunkInterface::getHighestLightLevel(int x, int z)
+uint8_t ChunkInterface::getHighestLightLevel(int x, int z)
 {
     (void)x;
     (void)z;
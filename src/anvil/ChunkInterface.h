@@ -16,7 +16,7 @@ public:
     ChunkInterface(nbt_node* chunk);
 
     /* Returns position of highest solod block at X and Z.*/
-    Uint8 getHighestSolidBlockY(int x, int z);
+    uint8_t getHighestSolidBlockY(int x, int z);
 
     /* Generic return a block ID at X,Y,Z */
     blocks::BlockID getBlockID(int x, int y, int z);
@@ -27,7 +27,7 @@ public:
 
     /* TODO: Gives the light level (0-15) of the highest block at X,Z.
      * With above, this can be used to draw lights */
-    Uint8 getHighestLightLevel(int x, int z);
+    uint8_t getHighestLightLevel(int x, int z);
 
 private:
     /* A "Section" is a 16x16x16 cube of blocks in a chunk. There are up
@@ -0,0 +1,43 @@
+#include "anvil/ChunkSurface.h"
+
+void ChunkSurface::extract(ChunkInterface& iface, const Deadline& deadline)
+{
+    for(int z = 0; z != 16; ++z)
+    {
+        //Cheap enough to do once a row
+        deadline.check("Reading chunk surface");
+
+        for(int x = 0; x != 16; ++x)
+        {
+            uint8_t y = iface.getHighestSolidBlockY(x, z);
+            blocks::BlockID id = iface.getBlockID(x, y, z);
+
+            int index = z*16 + x;
+            heights[index] = y;
+            if(id == blocks::invalidID) {
+                blockIDs[index] = invalidPacked;
+            } else {
+                blockIDs[index] = ((id.id & 0xFFF) << 4) | (id.meta & 0xF);
+            }
+        }
+    }
+}
+
+blocks::BlockID ChunkSurface::getBlockID(int x, int z) const
+{
+    uint16_t packed = blockIDs[z*16 + x];
+    if(packed == invalidPacked) {
+        return blocks::invalidID;
+    }
+    return blocks::BlockID(packed >> 4, packed & 0xF);
+}
+
+uint16_t ChunkSurface::getPackedID(int x, int z) const
+{
+    return blockIDs[z*16 + x];
+}
+
+uint8_t ChunkSurface::getHeight(int x, int z) const
+{
+    return heights[z*16 + x];
+}
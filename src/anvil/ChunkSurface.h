@@ -0,0 +1,40 @@
+#ifndef CHUNKSURFACE_H
+#define CHUNKSURFACE_H
+#include <array>
+#include <stdint.h>
+#include "anvil/ChunkInterface.h"
+#include "blocks/blocks.h"
+#include "utility/deadline.h"
+
+/* ChunkSurface
+ * The top-down view of a chunk: the highest solid block and its height
+ * for each of the 16x16 columns. This is everything a drawer looks at,
+ * extracted once per chunk from a ChunkInterface. It is plain data with a
+ * fixed size, so it can be copied around and shared between processes */
+
+struct ChunkSurface
+{
+public:
+    //Fill in the surface from a chunk. Throws if "deadline" expires
+    void extract(ChunkInterface& iface, const Deadline& deadline = Deadline());
+
+    //Highest solid block ID at x,z (0-15), or blocks::invalidID
+    blocks::BlockID getBlockID(int x, int z) const;
+
+    /* Highest solid block at x,z packed as (id << 4) | meta. Anvil ids are
+     * at most 12 bits (Blocks + Add nibble) and meta is 4 bits, so this is
+     * lossless, and can index a 4096x16 table directly (see BlockColors) */
+    uint16_t getPackedID(int x, int z) const;
+
+    //Y of the highest solid block at x,z (0-15)
+    uint8_t getHeight(int x, int z) const;
+
+    //Packed ID standing in for blocks::invalidID
+    static const uint16_t invalidPacked = 0xFFFF;
+
+private:
+    std::array<uint16_t, 16*16> blockIDs;
+    std::array<uint8_t, 16*16> heights;
+};
+
+#endif
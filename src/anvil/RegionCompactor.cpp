@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <zlib.h>
+#include "utility/utility.h"
+#include "utility/morton.h"
+#include "anvil/RegionFileWorld.h"
+#include "anvil/RegionCompactor.h"
+
+/* zlib helpers
+ * ========================================================================= */
+
+//Inflate a zlib or gzip stream in full. Throws if it's corrupt
+static std::string inflateAll(const std::vector<char>& data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    //15 + 32: the default window, and detect zlib or gzip from the header
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+        error("Could not start inflating");
+    }
+
+    std::string out;
+    char buffer[64 * 1024];
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+
+    int result = Z_OK;
+    while(result == Z_OK) {
+        stream.next_out = (Bytef*)buffer;
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+        if(result == Z_BUF_ERROR && stream.avail_in == 0) {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+
+    if(result != Z_STREAM_END) {
+        error("Corrupt compressed data (zlib error ", result, ")");
+    }
+    return out;
+}
+
+//Deflate as a zlib stream, at "level"
+static std::vector<char> deflateAll(const std::string& data, int level)
+{
+    uLongf length = compressBound(data.size());
+    std::vector<char> out(length);
+    if(compress2((Bytef*)out.data(), &length, (const Bytef*)data.data(), data.size(), level) != Z_OK) {
+        error("Could not compress chunk");
+    }
+    out.resize(length);
+    return out;
+}
+
+//Write an int big-endian at "dest"
+static void writeIntBE(char* dest, unsigned value)
+{
+    dest[0] = char(value >> 24);
+    dest[1] = char(value >> 16);
+    dest[2] = char(value >> 8);
+    dest[3] = char(value);
+}
+
+/* RegionCompactor
+ * ========================================================================= */
+
+//Compression type of a zlib chunk in a region file
+static const byte VERSION_DEFLATE = 2;
+
+RegionCompactor::RegionCompactor(int zlibLevel)
+    : zlibLevel(zlibLevel)
+{
+
+}
+
+bool RegionCompactor::compactWorld(const std::string& worldPath, const std::string& outputDir)
+{
+    bool ok = true;
+    Result total;
+
+    for(auto& file : RegionFileWorld::findRegionFiles(worldPath))
+    {
+        const std::string& inPath = file.second;
+        std::string outPath = outputDir.empty() ? inPath : outputDir + "/" + removePath(inPath);
+
+        try {
+            Result result = compactRegion(inPath, outPath);
+            log("  ", removePath(inPath), ": ", result.chunks, " chunks, ",
+                result.sectorsBefore, " -> ", result.sectorsAfter, " sectors (",
+                result.holesBefore, " free, ", result.seeksBefore, " out of order)");
+
+            total.chunks += result.chunks;
+            total.unverified += result.unverified;
+            total.sectorsBefore += result.sectorsBefore;
+            total.sectorsAfter += result.sectorsAfter;
+            total.holesBefore += result.holesBefore;
+            total.seeksBefore += result.seeksBefore;
+        }
+        catch(std::exception& ex) {
+            log("  ", removePath(inPath), ": not compacted: ", ex.what());
+            ok = false;
+        }
+    }
+
+    log("Compacted ", total.chunks, " chunks from ", size_t(total.sectorsBefore) * 4 / 1024, " MB to ",
+        size_t(total.sectorsAfter) * 4 / 1024, " MB; removed ", total.holesBefore, " free sectors and ",
+        total.seeksBefore, " out of order chunks");
+    if(total.unverified) {
+        log(total.unverified, " chunk(s) could not be inflated, and were copied unchanged");
+    }
+
+    return ok;
+}
+
+RegionCompactor::Result RegionCompactor::compactRegion(const std::string& inPath, const std::string& outPath)
+{
+    Result result;
+    std::vector<Chunk> chunks;
+    {
+        RegionFile region;
+        region.load(inPath);
+        result.sectorsBefore = region.getSectorCount();
+        result.holesBefore = region.getFreeSectorCount();
+        chunks = readChunks(region, result);
+    }
+
+    /* Write next to the destination first, and only move it into place once
+     * it reads back right. The name mustn't look like a region file */
+    std::string tempPath = outPath;
+    if(tempPath.size() > 4 && tempPath.compare(tempPath.size() - 4, 4, ".mca") == 0) {
+        tempPath.resize(tempPath.size() - 4);
+    }
+    tempPath += ".compacting";
+
+    try {
+        writeRegion(chunks, tempPath, result);
+        verifyRegion(chunks, tempPath);
+    }
+    catch(...) {
+        remove(tempPath.c_str());
+        throw;
+    }
+
+    //Replacing a file with rename only works on POSIX; clear the way first
+#ifdef _WIN32
+    remove(outPath.c_str());
+#endif
+    if(rename(tempPath.c_str(), outPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        error("Could not replace \"", outPath, "\"");
+    }
+
+    return result;
+}
+
+std::vector<RegionCompactor::Chunk> RegionCompactor::readChunks(RegionFile& region, Result& result)
+{
+    std::vector<Chunk> chunks;
+    unsigned nextSector = 0;
+
+    //Same order BaseDrawer::renderRegion walks chunks in
+    for(uint32_t i = 0; i != 32*32; ++i)
+    {
+        Chunk chunk;
+        chunk.x = morton::decodeX(i);
+        chunk.z = morton::decodeZ(i);
+        if(!region.hasChunk(chunk.x, chunk.z)) {
+            continue;
+        }
+
+        //Dropping a chunk the header lists would lose it; leave the region alone
+        if(!region.getChunkData(chunk.x, chunk.z, chunk.data, chunk.version)) {
+            error("chunk ", chunk.x, ",", chunk.z, " could not be read");
+        }
+        chunk.timestamp = region.getTimestamp(chunk.x, chunk.z);
+
+        //Would reading this chunk after the last one need a seek?
+        unsigned sector = region.getChunkSector(chunk.x, chunk.z);
+        if(nextSector != 0 && sector != nextSector) {
+            result.seeksBefore++;
+        }
+        nextSector = sector + region.getChunkSize(chunk.x, chunk.z) / RegionFile::SECTOR_BYTES;
+
+        /* Chunks that don't inflate (or aren't zlib/gzip at all) are kept
+         * byte for byte; there's nothing to check them against */
+        try {
+            chunk.inflated = inflateAll(chunk.data);
+        }
+        catch(std::exception& ex) {
+            log("    chunk ", chunk.x, ",", chunk.z, " copied unchanged: ", ex.what());
+            result.unverified++;
+        }
+
+        if(zlibLevel >= 0 && !chunk.inflated.empty()) {
+            chunk.data = deflateAll(chunk.inflated, zlibLevel);
+            chunk.version = VERSION_DEFLATE;
+        }
+
+        chunks.push_back(std::move(chunk));
+    }
+
+    result.chunks = chunks.size();
+    return chunks;
+}
+
+void RegionCompactor::writeRegion(const std::vector<Chunk>& chunks, const std::string& path, Result& result)
+{
+    const unsigned sectorBytes = RegionFile::SECTOR_BYTES;
+
+    //Two header sectors: offsets, then timestamps
+    std::string content(2 * sectorBytes, '\0');
+    for(const Chunk& chunk : chunks)
+    {
+        //Each chunk: 4 byte length (counting the version), version, data; padded to a sector
+        unsigned length = chunk.data.size() + 1;
+        unsigned sectors = (length + 4 + sectorBytes - 1) / sectorBytes;
+        if(sectors > 255) {
+            error("Chunk ", chunk.x, ",", chunk.z, " needs ", sectors, " sectors, more than a region can hold");
+        }
+
+        unsigned sector = content.size() / sectorBytes;
+        unsigned index = chunk.x + chunk.z * 32;
+        writeIntBE(&content[index * 4], sector << 8 | sectors);
+        writeIntBE(&content[sectorBytes + index * 4], chunk.timestamp);
+
+        size_t start = content.size();
+        content.resize(start + sectors * sectorBytes, '\0');
+        writeIntBE(&content[start], length);
+        content[start + 4] = char(chunk.version);
+        memcpy(&content[start + 5], chunk.data.data(), chunk.data.size());
+    }
+    result.sectorsAfter = content.size() / sectorBytes;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), content.size());
+    out.close();
+    if(!out) {
+        error("Could not write \"", path, "\"");
+    }
+}
+
+void RegionCompactor::verifyRegion(const std::vector<Chunk>& chunks, const std::string& path)
+{
+    RegionFile region;
+    region.load(path);
+
+    std::vector<char> data;
+    byte version = 0;
+    for(const Chunk& chunk : chunks)
+    {
+        if(!region.getChunkData(chunk.x, chunk.z, data, version)) {
+            error("Chunk ", chunk.x, ",", chunk.z, " is missing after compacting");
+        }
+        if(region.getTimestamp(chunk.x, chunk.z) != chunk.timestamp) {
+            error("Chunk ", chunk.x, ",", chunk.z, " lost its timestamp");
+        }
+
+        //Unverifiable chunks must at least come back byte for byte
+        bool same = chunk.inflated.empty() ? data == chunk.data
+                                           : inflateAll(data) == chunk.inflated;
+        if(!same) {
+            error("Chunk ", chunk.x, ",", chunk.z, " does not round-trip");
+        }
+    }
+}
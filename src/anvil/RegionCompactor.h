@@ -0,0 +1,70 @@
+#ifndef REGIONCOMPACTOR_H
+#define REGIONCOMPACTOR_H
+#include <string>
+#include <vector>
+#include "types.h"
+#include "anvil/RegionFile.h"
+
+/* RegionCompactor rewrites region files so chunks are stored back to back,
+ * in the order the renderer reads them (Morton order, see BaseDrawer), with
+ * no free sectors between them. Servers leave regions full of holes and
+ * scattered chunks as chunks grow and move; a compacted region is read
+ * front to back by a render.
+ *
+ * Chunks can optionally be recompressed at another zlib level. Either way,
+ * the new file is read back and every chunk is checked to inflate to the
+ * same bytes as before; only then does it replace (or sit beside) the
+ * original. This is meant to run offline, e.g. on a backup of a world. */
+
+class RegionCompactor
+{
+public:
+    //What compacting one region did
+    struct Result
+    {
+        unsigned chunks = 0;            //Chunks written
+        unsigned unverified = 0;        //Chunks copied as-is (couldn't be inflated)
+        unsigned sectorsBefore = 0;
+        unsigned sectorsAfter = 0;
+        unsigned holesBefore = 0;       //Free sectors in the original
+        unsigned seeksBefore = 0;       //Chunks not right after the previous one read
+    };
+
+public:
+    /* "zlibLevel" of 0-9 recompresses every chunk (as zlib) at that level;
+     * -1 keeps chunks compressed as they are */
+    RegionCompactor(int zlibLevel = -1);
+
+    /* Compact every region of the world at "worldPath". Rewritten regions go
+     * into "outputDir" if given, else replace the originals.
+     * Returns false if any region failed (those are left untouched) */
+    bool compactWorld(const std::string& worldPath, const std::string& outputDir = "");
+
+    //Compact a single region file into "outPath", which may be "inPath". Throws on failure
+    Result compactRegion(const std::string& inPath, const std::string& outPath);
+
+private:
+    int zlibLevel;
+
+    //One chunk to write, with everything needed to check it afterwards
+    struct Chunk
+    {
+        int x, z;
+        unsigned timestamp;
+        byte version;
+        std::vector<char> data;     //Compressed, as it'll be written
+        std::string inflated;       //Uncompressed, empty if unknown
+    };
+
+    /* Read every chunk of a region, in traversal order, recompressing if asked to.
+     * Throws if a chunk listed in the header can't be read */
+    std::vector<Chunk> readChunks(RegionFile& region, Result& result);
+
+    //Lay out the chunks back to back after the header, and write them to "path"
+    void writeRegion(const std::vector<Chunk>& chunks, const std::string& path, Result& result);
+
+    //Load "path" and check each chunk inflates to what it was
+    void verifyRegion(const std::vector<Chunk>& chunks, const std::string& path);
+};
+
+#endif
@@ -56,8 +56,12 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include "utility/utility.h"
 #include "anvil/RegionFile.h"
+#include "anvil/nbtutility.h"
+#include "utility/background.h"
+#include "io/Storage.h"
 
 /* I/O Helpers, mostly from cNBT
  * ========================================================================= */
@@ -109,6 +113,58 @@ byte readByte(std::iostream& s)
     return ret;
 }
 
+/* Read part of a file of "fileSize" bytes from the storage backend (see io::storage),
+ * throttled by background::throttleRead. Returns fewer bytes at the end of the file.
+ * Only what's there to read counts against the limit. With a limited "deadline",
+ * the read is done in pieces, and throws once the deadline passes */
+static std::string readThrottled(const std::string& path, uint64_t fileSize, uint64_t offset, size_t length,
+                                 const Deadline& deadline = Deadline())
+{
+    if(offset >= fileSize) {
+        return std::string();
+    }
+    length = std::min<uint64_t>(length, fileSize - offset);
+
+    const size_t pieceSize = deadline.isLimited() ? 64 * 1024 : length;
+    std::string content(length, '\0');
+    size_t done = 0;
+    while(done != length)
+    {
+        deadline.check("Reading chunk");
+        size_t want = std::min(pieceSize, length - done);
+        background::throttleRead(want);
+        size_t got = io::storage().read(path, offset + done, want, &content[done]);
+        done += got;
+        if(got != want) {
+            break;
+        }
+    }
+    content.resize(done);
+    deadline.check("Reading chunk");
+    return content;
+}
+
+//Same as above for a whole file, a piece at a time. Empty on failure
+static std::string readThrottled(const std::string& path)
+{
+    try {
+        uint64_t size = io::storage().fileSize(path);
+        const size_t pieceSize = 1024 * 1024;
+        std::string content;
+        for(uint64_t offset = 0; offset < size; offset += pieceSize) {
+            std::string piece = readThrottled(path, size, offset, pieceSize);
+            if(piece.empty()) {
+                break;
+            }
+            content += piece;
+        }
+        return content;
+    }
+    catch(std::exception&) {
+        return std::string();
+    }
+}
+
 /* RegionFile
  * ========================================================================= */
 
@@ -121,7 +177,7 @@ RegionFile::RegionFile()
 
 RegionFile::~RegionFile()
 {
-    for(auto& pair : knownChunkData) {
+    for(auto pair : knownChunkData) {
         nbt_free(pair.second);
     }
 }
@@ -129,15 +185,33 @@ RegionFile::~RegionFile()
 void RegionFile::load(const std::string& path)
 {
     //Load entire file into string
-    std::string fileContent = readFile(path);
+    std::string fileContent = readThrottled(path);
     if(fileContent.empty()) {
         error("Could not load region file \"", path, "\"");
     }
 
     //Create stream on file for easy seeking and reading
     file.str(fileContent);
+    headerOnly = false;
+
+    readHeader(getLength(file));
+}
 
-    int fileLength = getLength(file);
+void RegionFile::loadHeader(const std::string& path)
+{
+    uint64_t fileLength = io::storage().fileSize(path);
+
+    //Just the two header sectors
+    file.str(readThrottled(path, fileLength, 0, 2 * SECTOR_BYTES));
+    headerOnly = true;
+    this->path = path;
+    pathLength = fileLength;
+
+    readHeader(fileLength);
+}
+
+void RegionFile::readHeader(long fileLength)
+{
     offsets.resize(SECTOR_INTS, 0);
 
     /* set up the available sector map. Sectors 0 and 1 are
@@ -159,8 +233,12 @@ void RegionFile::load(const std::string& path)
         }
     }
 
-    /* The next SECTOR_INTS ints (sector 2) would be the timestamps--the last saved time
-     * of the chunk. We don't care about them here, so they're not loaded */
+    /* The next SECTOR_INTS ints (sector 2) are the timestamps--the last saved time
+     * of the chunk. These tell cached copies of a chunk apart from newer saves */
+    timestamps.resize(SECTOR_INTS, 0);
+    for (int i = 0; i < SECTOR_INTS; ++i) {
+        timestamps[i] = readInt(file);
+    }
 
     //Mark this as being loaded correctly
     isLoaded = true;
@@ -171,23 +249,37 @@ bool RegionFile::hasChunk(int x, int z)
     return getOffset(x, z) != 0;
 }
 
+unsigned RegionFile::getTimestamp(int x, int z)
+{
+    if (outOfBounds(x, z) || !isLoaded) {
+        return 0;
+    }
+    return timestamps[x + z * 32];
+}
+
 const RegionFile::ChunkMap& RegionFile::getAllChunks()
 {
     if(!knowAllChunks) {
         for(int x = 0; x != 32; ++x)
         for(int z = 0; z != 32; ++z) {
-            nbt_node* nbt = getChunkNBT(x,z);
-            if(nbt) {
-                knownChunkData[MC_Point{x,z}] = nbt;
-            }
+            //getChunkNBT stores the chunk in knownChunkData
+            getChunkNBT(x,z);
         }
         knowAllChunks = true;
     }
     return knownChunkData;
 }
 
-/* Returns the NBT tree for the chunk at X and Z */
-nbt_node* RegionFile::getChunkNBT(int x, int z)
+/* Space the chunk at X and Z takes up in the file, from its sector count in the header */
+size_t RegionFile::getChunkSize(int x, int z)
+{
+    if (outOfBounds(x, z) || !isLoaded) {
+        return 0;
+    }
+    return size_t(getOffset(x, z) & 0xFF) * SECTOR_BYTES;
+}
+
+nbt_node* RegionFile::getChunkNBT(int x, int z, const Deadline& deadline)
 {
     if (outOfBounds(x, z)) {
         error("Chunk: ", x, z, " out of bounds");
@@ -201,12 +293,39 @@ nbt_node* RegionFile::getChunkNBT(int x, int z)
         return nullptr;
     }
     //Check to see if we've cached it before
-    auto it = knownChunkData.find(MC_Point{x,z});
-    if(it != knownChunkData.end()) {
-        return it->second;
+    if(knownChunkData.isKnown(x,z)) {
+        return knownChunkData.get(x,z);
     }
 
     //Now to actually load the chunk
+    std::vector<char> data;
+    byte version = 0;
+    if(!getChunkData(x, z, data, version, deadline)) {
+        return nullptr;
+    }
+
+    /* The compression type is either GZIP (1) or DEFLATE (2), but according
+     * to Wiki, only 2 is used in practice; the inflater handles both anyway.
+     * Only inflate as much as the required tags need; everything if there are none */
+    size_t skipped = 0;
+    size_t dataLength = data.size();
+    nbt_node* nbt = nbtutil::parseCompressedUntil(data.data(), dataLength, requiredLevelTags,
+                                                 &skipped, deadline);
+    compressedBytesRead += dataLength;
+    compressedBytesSkipped += skipped;
+
+    //Record that we know chunk data at this coordinate before returning
+    knownChunkData.set(x, z, nbt);
+
+    //Return NBT data
+    return nbt;
+}
+
+bool RegionFile::getChunkData(int x, int z, std::vector<char>& data, byte& version, const Deadline& deadline)
+{
+    if (outOfBounds(x, z) || !isLoaded || !hasChunk(x, z)) {
+        return false;
+    }
 
     //Offset of chunk at x,z in bytes
     int offset = getOffset(x, z);
@@ -217,31 +336,67 @@ nbt_node* RegionFile::getChunkNBT(int x, int z)
     unsigned numSectors = offset & 0xFF;
     if (sectorNumber + numSectors > sectorFree.size()) {
         log("Chunk: ", x, z, " invalid sector");
-        return nullptr;
+        return false;
+    }
+
+    //With only the header in memory, read just the chunk's sectors
+    std::stringstream sectors;
+    std::iostream* source = &file;
+    uint64_t start = uint64_t(sectorNumber) * SECTOR_BYTES;
+    if(headerOnly) {
+        sectors.str(readThrottled(path, pathLength, start, numSectors * SECTOR_BYTES, deadline));
+        source = &sectors;
+        start = 0;
     }
 
     //Seek to the chunk sector. Length of chunk is the first int at sector
-    file.seekg(sectorNumber * SECTOR_BYTES);
-    unsigned length = readInt(file);
+    source->seekg(start);
+    unsigned length = readInt(*source);
     if (length > SECTOR_BYTES * numSectors) {
         error("Chunk: ", x, z, "invalid length: ", length, " > 4096 * ", numSectors);
-        return nullptr;
+        return false;
     }
 
-    /* Next byte: Version of compression. Either GZIP (1) or DEFLATE (2),
-     * But according to Wiki, only 2 is used in practice. Ignoring this */
-    readByte(file);
+    //Next byte: Version of compression, counted in the length
+    version = readByte(*source);
 
     //Next data: Compressed chunk NBT data. What we're after!
-    std::vector<char> data(length);
-    file.read(data.data(), length);
-    nbt_node* nbt = nbt_parse_compressed(data.data(), length);
+    data.resize(length > 0 ? length - 1 : 0);
+    source->read(data.data(), data.size());
+    return true;
+}
 
-    //Record that we know chunk data at this coordinate before returning
-    knownChunkData[MC_Point{x,z}] = nbt;
+unsigned RegionFile::getChunkSector(int x, int z)
+{
+    if (outOfBounds(x, z) || !isLoaded) {
+        return 0;
+    }
+    return unsigned(getOffset(x, z)) >> 8;
+}
 
-    //Return NBT data
-    return nbt;
+unsigned RegionFile::getSectorCount() const
+{
+    return sectorFree.size();
+}
+
+unsigned RegionFile::getFreeSectorCount() const
+{
+    return std::count(sectorFree.begin(), sectorFree.end(), true);
+}
+
+void RegionFile::setRequiredLevelTags(const std::vector<std::string>& tags)
+{
+    requiredLevelTags = tags;
+}
+
+size_t RegionFile::getCompressedBytesRead() const
+{
+    return compressedBytesRead;
+}
+
+size_t RegionFile::getCompressedBytesSkipped() const
+{
+    return compressedBytesSkipped;
 }
 
 /* is this an invalid chunk coordinate? */
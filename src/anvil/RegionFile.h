@@ -4,58 +4,110 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
-#include <map>
 #include <nbt/nbt.h>
 #include "types.h"
+#include "anvil/SpatialContainers.h"
+#include "utility/deadline.h"
 
 /* Interface to a Anvil .mca Region file.
  * Converted from Java from http://pastebin.com/niWTqLvk
- * Stripped + optimized to only include reading */
+ * Stripped + optimized to only include reading
+ * (see RegionCompactor for rewriting region files) */
 
 class RegionFile
 {
 public:
-    //Map of chunk coordinates to their cached NBT data
-    typedef std::map<MC_Point, nbt_node*> ChunkMap;
+    //Grid of chunk coordinates to their cached NBT data
+    typedef ChunkGrid ChunkMap;
 
 public:
+    //Bytes in a file sector
+    static const int SECTOR_BYTES = 4096;
+    //Number of ints in a sector
+    static const int SECTOR_INTS = SECTOR_BYTES / 4;
+
     RegionFile();
    ~RegionFile();
 
     //Load the region from a file
     void load(const std::string& path);
 
+    /* Only read the header (chunk locations and timestamps) of a region file.
+     * Chunks are then read from the file one at a time, when asked for.
+     * For touching a few chunks of many regions without reading them all */
+    void loadHeader(const std::string& path);
+
     //Is there a chunk at this X and Z?
     bool hasChunk(int x, int z);
 
+    //Last time the chunk at X and Z was saved (seconds since epoch), 0 if unknown
+    unsigned getTimestamp(int x, int z);
+
     //Return all chunk NBT in the region, mapped by their X/Z coordinate
     const ChunkMap& getAllChunks();
 
+    //Space the chunk at X and Z takes up in the file, in bytes (0 if none)
+    size_t getChunkSize(int x, int z);
+
     /* Returns the NBT tree for the chunk at X and Z
-     * or nullptr if none exists */
-    nbt_node* getChunkNBT(int x, int z);
+     * or nullptr if none exists. Throws if reading, inflating or parsing
+     * it runs past "deadline" */
+    nbt_node* getChunkNBT(int x, int z, const Deadline& deadline = Deadline());
 
-private:
+    /* Copy the chunk at X and Z as stored, still compressed, into "data",
+     * and its compression type (1 gzip, 2 zlib) into "version".
+     * Returns false if there is no such chunk, or its sectors are invalid.
+     * Throws if reading it from the file runs past "deadline" */
+    bool getChunkData(int x, int z, std::vector<char>& data, byte& version,
+                      const Deadline& deadline = Deadline());
 
-    //Constants
-    //Bytes in a file sector
-    static const int SECTOR_BYTES = 4096;
-    //Number of ints in a sector
-    static const int SECTOR_INTS = SECTOR_BYTES / 4;
+    //First sector of the chunk at X and Z, 0 if none
+    unsigned getChunkSector(int x, int z);
+
+    //Sectors in the file, and how many of those no chunk uses (holes)
+    unsigned getSectorCount() const;
+    unsigned getFreeSectorCount() const;
+
+    /* Only parse chunks as far as needed to read these tags under "Level",
+     * e.g. {"HeightMap", "Sections"} for drawing the surface. Chunks loaded
+     * afterwards only contain the tags before and including these.
+     * An empty list (the default) parses whole chunks */
+    void setRequiredLevelTags(const std::vector<std::string>& tags);
 
+    //Compressed bytes of chunk data read so far, and how many of them
+    //were never inflated thanks to setRequiredLevelTags
+    size_t getCompressedBytesRead() const;
+    size_t getCompressedBytesSkipped() const;
+
+private:
     //Variabes
     //"offsets" Indicates the offset in bytes into the region file of each chunk
+    //"timestamps" Indicates the last modification time of each chunk
     //"sectorFree" Indicates if a sector is free or not.
     std::vector<int> offsets;
+    std::vector<unsigned> timestamps;
     std::vector<bool> sectorFree;
     bool isLoaded;
     bool knowAllChunks;
 
+    //Loaded with loadHeader: chunks are read from "path" (of "pathLength" bytes) instead of "file"
+    bool headerOnly = false;
+    std::string path;
+    uint64_t pathLength = 0;
+
+    //See setRequiredLevelTags and its getters
+    std::vector<std::string> requiredLevelTags;
+    size_t compressedBytesRead = 0;
+    size_t compressedBytesSkipped = 0;
+
     //The input steam to the file's content, and the file's content in full
     //knownChunkData is the most important, all the stored chunks data.
     std::stringstream file;
     ChunkMap knownChunkData;
 
+    //Read the offsets and timestamps from the start of "file"
+    void readHeader(long fileLength);
+
     //is this an invalid chunk coordinate?
     bool outOfBounds(int x, int z);
 
@@ -9,7 +9,18 @@
 #include "anvil/RegionFileWorld.h"
 
 RegionFileWorld::RegionFileWorld(std::string rootpath)
+    : path(rootpath)
 {
+    for(auto& file : findRegionFiles(rootpath)) {
+        regions[file.first].load(file.second);
+    }
+}
+
+std::vector<std::pair<RegionFileWorld::RegionCoord,std::string>>
+    RegionFileWorld::findRegionFiles(const std::string& worldpath)
+{
+    std::vector<std::pair<RegionCoord,std::string>> files;
+    std::string rootpath = worldpath;
     DIR* dp;
     struct dirent* entry;
 
@@ -20,17 +31,19 @@ RegionFileWorld::RegionFileWorld(std::string rootpath)
         error("Could not load region folder in ", rootpath);
     }
 
-    /* Traverse the region/ directory, load each .mca, and load it
-     * into the region map */
+    /* Traverse the region/ directory, and note each .mca in it */
     while((entry = readdir(dp)) != NULL)
     {
         auto pair = parseFilename(entry->d_name);
         bool isValid = pair.first;
         if(isValid) {
             RegionCoord coords = pair.second;
-            regions[coords].load(rootpath + std::string(entry->d_name));
+            files.emplace_back(coords, rootpath + std::string(entry->d_name));
         }
-    } 
+    }
+    closedir(dp);
+
+    return files;
 }
 
 RegionFileWorld::RegionMap& RegionFileWorld::getAllRegions()
@@ -38,6 +51,17 @@ RegionFileWorld::RegionMap& RegionFileWorld::getAllRegions()
     return regions;
 }
 
+const std::string& RegionFileWorld::getPath() const
+{
+    return path;
+}
+
+RegionFile* RegionFileWorld::getRegion(const RegionCoord& coord)
+{
+    auto* entry = regions.find(coord);
+    return entry ? &entry->second : nullptr;
+}
+
 MC_Point RegionFileWorld::getSize()
 {
     /* Given the region coordinates, find out min and max
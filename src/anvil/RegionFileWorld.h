@@ -1,7 +1,9 @@
 #ifndef REGIONFILEWORLD_H
 #define REGIONFILEWORLD_H
-#include <map>
+#include <vector>
+#include <utility>
 #include "anvil/RegionFile.h"
+#include "anvil/SpatialContainers.h"
 
 /* RegionFileWorld is a world of Anvil regions (RegionFiles). It traverses
  * the region/ directory and loads each region, and provides
@@ -13,8 +15,9 @@ public:
     //- A region coordinate such as -1,2 -- from the .mca filenames
     typedef MC_Point RegionCoord;
 
-    //- Map type for {-1,2} -> region data
-    typedef std::map<RegionCoord, RegionFile> RegionMap;
+    //- Map type for {-1,2} -> region data. Hashed on the coordinate,
+    //  iterates in the order regions were found
+    typedef PointHashMap<RegionFile> RegionMap;
 
 public:
     /* Initialize from the root of a Minecraft world.
@@ -24,17 +27,30 @@ public:
     //Return all the regions
     RegionMap& getAllRegions();
 
+    //Return the region at a region coordinate, or nullptr if there's none
+    RegionFile* getRegion(const RegionCoord& coord);
+
+    //Return the world root path this was loaded from
+    const std::string& getPath() const;
+
     //Get X/Z size of the world in blocks
     MC_Point getSize();
 
+    /* List the .mca files in a world's region/ directory, with their
+     * coordinates, without loading them. Throws if there's no such directory */
+    static std::vector<std::pair<RegionCoord,std::string>> findRegionFiles(const std::string& rootpath);
+
 private:
     //From a "r.1.-1.mca", get the 1 and -1. Also validates the name.
     // return.first == true if valid, return.second is the value if valid
-    std::pair<bool,RegionCoord> parseFilename(const std::string& filename);
+    static std::pair<bool,RegionCoord> parseFilename(const std::string& filename);
 
     /* Stored regions. Maps a pair of integers, such as
      * -1,0 to the .mca region. */
     RegionMap regions;
+
+    //Root of the world, as given to the constructor
+    std::string path;
 };
 
 #endif
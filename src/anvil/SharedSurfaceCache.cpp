@@ -0,0 +1,330 @@
+#ifndef _WIN32
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "utility/utility.h"
+#include "anvil/SharedSurfaceCache.h"
+
+namespace
+{
+
+//"PWNSURF1"; written last by the creator, once the segment is ready to use
+const uint64_t cacheMagic = 0x50574E5355524631ULL;
+const uint32_t cacheVersion = 3;
+
+bool sameKey(const SharedSurfaceCache::Key& a, const SharedSurfaceCache::Key& b)
+{
+    return a.world == b.world &&
+           a.regionX == b.regionX && a.regionZ == b.regionZ &&
+           a.chunkX == b.chunkX && a.chunkZ == b.chunkZ &&
+           a.timestamp == b.timestamp;
+}
+
+//FNV-1a over some bytes, continuing from "hash"
+uint64_t fnv1a(const void* data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for(size_t i = 0; i != len; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Milliseconds on a clock every process on the machine agrees on
+ * (steady_clock is CLOCK_MONOTONIC, counted from boot, on Linux).
+ * Only the low 32 bits are kept; differences are taken modulo 2^32 */
+uint32_t nowMs()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+//A slot's state word: its sequence counter on top, the start of its last write below
+uint64_t makeState(uint32_t sequence, uint32_t startMs)
+{
+    return uint64_t(sequence) << 32 | startMs;
+}
+
+uint32_t sequenceOf(uint64_t state)
+{
+    return uint32_t(state >> 32);
+}
+
+uint32_t startOf(uint64_t state)
+{
+    return uint32_t(state);
+}
+
+//Checksum of an entry, to catch slots mixing two writes
+uint64_t checksumOf(const SharedSurfaceCache::Key& key, const ChunkSurface& surface)
+{
+    //Field by field; Key may have padding bytes
+    uint64_t hash = fnv1a(&key.world, sizeof key.world);
+    hash = fnv1a(&key.regionX, sizeof key.regionX, hash);
+    hash = fnv1a(&key.regionZ, sizeof key.regionZ, hash);
+    hash = fnv1a(&key.chunkX, sizeof key.chunkX, hash);
+    hash = fnv1a(&key.chunkZ, sizeof key.chunkZ, hash);
+    hash = fnv1a(&key.timestamp, sizeof key.timestamp, hash);
+    return fnv1a(&surface, sizeof surface, hash);
+}
+
+}
+
+/* Shared memory layout: one Header, followed by Header::setCount Sets.
+ * Everything is zero when the segment is created, which is a valid
+ * empty state (sequence 0 = slot never written) */
+
+struct SharedSurfaceCache::Header
+{
+    std::atomic<uint64_t> magic;
+    uint32_t version;
+    uint32_t setCount;
+};
+
+struct SharedSurfaceCache::Slot
+{
+    /* Sequence counter and, next to it, when the current (or last) write
+     * started (see makeState). The sequence is odd while a writer is filling
+     * the slot in, and bumped by two for every write. Readers retry if it
+     * changed under them. Both halves change in the one CAS that claims the slot */
+    std::atomic<uint64_t> state;
+    //Clock "second chance" bit, set on every hit
+    std::atomic<uint8_t> referenced;
+
+    Key key;
+    ChunkSurface surface;
+    //checksumOf(key, surface), written along with them
+    uint64_t checksum;
+};
+
+struct SharedSurfaceCache::Set
+{
+    //Clock hand; the next slot to consider for eviction
+    std::atomic<uint32_t> hand;
+    Slot slots[setSize];
+};
+
+SharedSurfaceCache::SharedSurfaceCache(const std::string& name, uint32_t slotCount)
+    : name(name), hits(0), misses(0)
+{
+#ifdef _WIN32
+    (void)slotCount;
+    error("Shared chunk cache \"", name, "\" is not supported on this platform");
+#else
+    uint32_t setCount = std::max(1u, slotCount / setSize);
+    size_t size = sizeof(Header) + setCount * sizeof(Set);
+    bool created = false;
+
+    //Try to be the one creating the segment; otherwise open the existing one
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd >= 0) {
+        created = true;
+        if(ftruncate(fd, size) != 0) {
+            int err = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            error("Could not size shared cache \"", name, "\": ", strerror(err));
+        }
+    }
+    else if(errno == EEXIST) {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if(fd < 0) {
+            error("Could not open shared cache \"", name, "\": ", strerror(errno));
+        }
+
+        //The creator might not have sized it yet; give it a moment
+        struct stat st;
+        for(int tries = 0; fstat(fd, &st) == 0 && st.st_size == 0 && tries != 100; ++tries) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        size = st.st_size;
+        if(size < sizeof(Header)) {
+            close(fd);
+            error("Shared cache \"", name, "\" is not initialized");
+        }
+    }
+    else {
+        error("Could not create shared cache \"", name, "\": ", strerror(errno));
+    }
+
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        mapping = nullptr;
+        error("Could not map shared cache \"", name, "\": ", strerror(errno));
+    }
+    mappingSize = size;
+
+    header = static_cast<Header*>(mapping);
+    sets = reinterpret_cast<Set*>(header + 1);
+
+    if(created) {
+        header->version = cacheVersion;
+        header->setCount = setCount;
+        header->magic.store(cacheMagic, std::memory_order_release);
+        return;
+    }
+
+    //Wait for the creator to finish, then make sure we agree on the layout
+    for(int tries = 0; header->magic.load(std::memory_order_acquire) != cacheMagic && tries != 100; ++tries) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if(header->magic.load(std::memory_order_acquire) != cacheMagic ||
+       header->version != cacheVersion ||
+       sizeof(Header) + header->setCount * sizeof(Set) > mappingSize)
+    {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        error("Shared cache \"", name, "\" has an incompatible layout; remove it and retry");
+    }
+#endif
+}
+
+SharedSurfaceCache::~SharedSurfaceCache()
+{
+    /* The segment itself is left in place for other (and later) renders.
+     * It can be removed with shm_unlink, or by deleting /dev/shm/<name> on Linux */
+#ifndef _WIN32
+    if(mapping) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+}
+
+bool SharedSurfaceCache::lookup(const Key& key, ChunkSurface& out)
+{
+    Set& set = sets[setOf(key)];
+
+    for(Slot& slot : set.slots)
+    {
+        uint64_t before = slot.state.load(std::memory_order_acquire);
+        uint32_t sequence = sequenceOf(before);
+        if(sequence == 0 || (sequence & 1)) {
+            continue; //Empty, or being written
+        }
+
+        Key slotKey = slot.key;
+        if(!sameKey(slotKey, key)) {
+            continue;
+        }
+        out = slot.surface;
+        uint64_t checksum = slot.checksum;
+
+        //If the state moved, a writer replaced the slot while we copied it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.state.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+
+        //A writer that was taken over may have mixed its write into the slot
+        if(checksum != checksumOf(slotKey, out)) {
+            continue;
+        }
+
+        slot.referenced.store(1, std::memory_order_relaxed);
+        ++hits;
+        return true;
+    }
+
+    ++misses;
+    return false;
+}
+
+void SharedSurfaceCache::publish(const Key& key, const ChunkSurface& surface)
+{
+    Set& set = sets[setOf(key)];
+
+    //Another process may have beaten us to it
+    for(Slot& slot : set.slots) {
+        uint32_t sequence = sequenceOf(slot.state.load(std::memory_order_acquire));
+        if(sequence != 0 && !(sequence & 1) && sameKey(slot.key, key)) {
+            return;
+        }
+    }
+
+    /* Clock eviction: walk from the hand, clearing referenced bits, and
+     * take the first slot that wasn't referenced since the last pass.
+     * Two laps are always enough unless other writers hold slots */
+    for(uint32_t tries = 0; tries != setSize * 2; ++tries)
+    {
+        Slot& slot = set.slots[set.hand.fetch_add(1, std::memory_order_relaxed) % setSize];
+
+        if(slot.referenced.exchange(0, std::memory_order_relaxed)) {
+            continue;
+        }
+
+        /* An odd sequence means someone is writing. If that's been going on
+         * for far longer than a write takes, the writer is gone (or stuck);
+         * take the slot over, keeping the sequence odd until our write is done.
+         * The start time is claimed with the sequence, so it's always the
+         * current writer's */
+        uint64_t state = slot.state.load(std::memory_order_relaxed);
+        uint32_t sequence = sequenceOf(state);
+        uint32_t writing = sequence + 1;
+        if(sequence & 1) {
+            if(uint32_t(nowMs() - startOf(state)) < staleWriteMs) {
+                continue;
+            }
+            writing = sequence + 2;
+        }
+        uint64_t claimed = makeState(writing, nowMs());
+        if(!slot.state.compare_exchange_strong(state, claimed, std::memory_order_acq_rel)) {
+            continue;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.key = key;
+        slot.surface = surface;
+        slot.checksum = checksumOf(key, surface);
+        slot.referenced.store(1, std::memory_order_relaxed);
+
+        //Only publish if nobody took the slot over from us in the meantime
+        slot.state.compare_exchange_strong(claimed, makeState(writing + 1, startOf(claimed)),
+                                           std::memory_order_release);
+        return;
+    }
+}
+
+uint64_t SharedSurfaceCache::hashWorld(const std::string& path)
+{
+    std::string resolved = path;
+#ifndef _WIN32
+    char* real = realpath(path.c_str(), nullptr);
+    if(real) {
+        resolved = real;
+        free(real);
+    }
+#endif
+    return fnv1a(resolved.data(), resolved.size());
+}
+
+uint64_t SharedSurfaceCache::getHits() const
+{
+    return hits;
+}
+
+uint64_t SharedSurfaceCache::getMisses() const
+{
+    return misses;
+}
+
+uint32_t SharedSurfaceCache::setOf(const Key& key) const
+{
+    //Hash field by field; Key may have padding bytes
+    uint64_t hash = fnv1a(&key.world, sizeof key.world);
+    hash = fnv1a(&key.regionX, sizeof key.regionX, hash);
+    hash = fnv1a(&key.regionZ, sizeof key.regionZ, hash);
+    hash = fnv1a(&key.chunkX, sizeof key.chunkX, hash);
+    hash = fnv1a(&key.chunkZ, sizeof key.chunkZ, hash);
+    hash = fnv1a(&key.timestamp, sizeof key.timestamp, hash);
+    return hash % header->setCount;
+}
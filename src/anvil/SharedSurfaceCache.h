@@ -0,0 +1,84 @@
+#ifndef SHAREDSURFACECACHE_H
+#define SHAREDSURFACECACHE_H
+#include <string>
+#include <atomic>
+#include <stdint.h>
+#include "anvil/ChunkSurface.h"
+
+/* SharedSurfaceCache is a cache of ChunkSurfaces in a POSIX shared memory
+ * segment, so several renderer processes working on the same world only
+ * decode each chunk once. The first process to decode a chunk publishes
+ * its surface; everyone else copies it out instead of decompressing.
+ *
+ * Entries are keyed by (world, region, chunk, chunk timestamp), so a chunk
+ * re-saved by the server gets a new key and the stale entry ages out.
+ * The segment is split into small sets of slots. Lookups are lock-free
+ * (each slot is guarded by a sequence counter) and a full set evicts with
+ * the clock (second chance) policy. Publishing is best-effort: if another
+ * writer holds the slot, the entry is simply not cached. A slot left
+ * mid-write for over staleWriteMs (e.g. by a writer that crashed) is
+ * taken over by the next eviction that reaches it. A writer that was only
+ * slow may still be writing after that, so every entry also carries a
+ * checksum of its key and surface, and lookups ignore entries that don't
+ * match theirs. */
+
+class SharedSurfaceCache
+{
+public:
+    //Identifies a chunk of a world at a point in time
+    struct Key
+    {
+        uint64_t world;     //Hash of the world path, see hashWorld()
+        int32_t regionX, regionZ;
+        int32_t chunkX, chunkZ;
+        uint32_t timestamp; //Last modified time from the region header
+    };
+
+public:
+    /* Open (or create) the segment "name", e.g. "/pwnsian-cache".
+     * "slotCount" is only used when creating; an existing segment is used
+     * at whatever size it was made. Throws if shared memory is unavailable */
+    SharedSurfaceCache(const std::string& name, uint32_t slotCount = defaultSlots);
+   ~SharedSurfaceCache();
+    SharedSurfaceCache(const SharedSurfaceCache&) = delete;
+
+    //Copy the cached surface for "key" into "out". Returns false on a miss
+    bool lookup(const Key& key, ChunkSurface& out);
+
+    //Add a surface to the cache, evicting an old one if needed
+    void publish(const Key& key, const ChunkSurface& surface);
+
+    /* Hash a world path into a Key::world value. The path is resolved first
+     * (realpath), so every way of naming the same world shares entries */
+    static uint64_t hashWorld(const std::string& path);
+
+    //Hit/miss counters for this process
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+public:
+    //Slots per set; a key can only live in one set
+    static const uint32_t setSize = 8;
+    //About 64K slots; a bit over 50MB of shared memory
+    static const uint32_t defaultSlots = 1 << 16;
+    //A write takes microseconds; one taking this long is from a dead writer
+    static const uint32_t staleWriteMs = 1000;
+
+private:
+    struct Header;
+    struct Slot;
+    struct Set;
+
+    std::string name;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    Header* header = nullptr;
+    Set* sets = nullptr;
+
+    std::atomic<uint64_t> hits, misses;
+
+    //Which set a key belongs to
+    uint32_t setOf(const Key& key) const;
+};
+
+#endif
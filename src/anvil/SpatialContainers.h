@@ -0,0 +1,192 @@
+#ifndef SPATIALCONTAINERS_H
+#define SPATIALCONTAINERS_H
+#include <array>
+#include <bitset>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <nbt/nbt.h>
+#include "types.h"
+
+/* Flat containers for things laid out on the X/Z grid, used in place of
+ * std::map<MC_Point, ...>. Lookups are O(1) and iteration walks memory in order */
+
+/* ChunkGrid
+ * Fixed 32x32 slot array of the chunks in a region, with a bitmap of which
+ * slots have been looked up. Slots are indexed x + z*32, the same as the
+ * region file header, so iteration runs in file header order. */
+class ChunkGrid
+{
+public:
+    static const int width = 32;
+    static const int slots = width * width;
+
+    //What iteration yields: chunk coordinate in the region and its NBT
+    typedef std::pair<MC_Point, nbt_node*> value_type;
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const ChunkGrid* grid, int index)
+            : grid(grid), index(index) { skipEmpty(); }
+
+        value_type operator*() const {
+            return { MC_Point{index % width, index / width}, grid->chunks[index] };
+        }
+        const_iterator& operator++() {
+            ++index;
+            skipEmpty();
+            return *this;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return index != other.index;
+        }
+
+    private:
+        const ChunkGrid* grid;
+        int index;
+
+        //Move forward to the next slot holding a chunk
+        void skipEmpty() {
+            while(index < slots && !grid->chunks[index]) {
+                ++index;
+            }
+        }
+    };
+
+public:
+    ChunkGrid() {
+        chunks.fill(nullptr);
+    }
+
+    //Has a chunk at x,z been stored (even if it was stored as nullptr)?
+    bool isKnown(int x, int z) const {
+        return known.test(indexOf(x,z));
+    }
+
+    //The chunk at x,z, or nullptr if there is none or it isn't known yet
+    nbt_node* get(int x, int z) const {
+        return chunks[indexOf(x,z)];
+    }
+
+    void set(int x, int z, nbt_node* chunk) {
+        int i = indexOf(x,z);
+        chunks[i] = chunk;
+        known.set(i);
+    }
+
+    //Iterate over stored, non-null chunks
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots); }
+
+private:
+    std::array<nbt_node*, slots> chunks;
+    std::bitset<slots> known;
+
+    static int indexOf(int x, int z) {
+        return x + z * width;
+    }
+};
+
+/* PointHashMap
+ * Map of MC_Point -> T using open addressing (linear probing) on the packed
+ * point. Values live in a deque in insertion order, so they never move once
+ * inserted (T need not be copyable or movable) and iteration is in memory order.
+ * Elements have "first" (the point) and "second" (the value), like std::map. */
+template<typename T>
+class PointHashMap
+{
+public:
+    struct value_type
+    {
+        value_type(const MC_Point& point) : first(point), second() { }
+        const MC_Point first;
+        T second;
+    };
+
+    typedef typename std::deque<value_type>::iterator iterator;
+    typedef typename std::deque<value_type>::const_iterator const_iterator;
+
+public:
+    PointHashMap() {
+        table.assign(16, EMPTY);
+    }
+
+    //Return the value at "point", default constructing it if not there
+    T& operator[](const MC_Point& point) {
+        value_type* found = find(point);
+        if(found) {
+            return found->second;
+        }
+
+        //Keep the table at most half full so probe runs stay short
+        if((entries.size() + 1) * 2 > table.size()) {
+            rehash(table.size() * 2);
+        }
+
+        entries.emplace_back(point);
+        insertIndex(point, entries.size() - 1);
+        return entries.back().second;
+    }
+
+    //Return the element at "point", or nullptr
+    value_type* find(const MC_Point& point) {
+        size_t mask = table.size() - 1;
+        for(size_t slot = hash(point) & mask; table[slot] != EMPTY; slot = (slot + 1) & mask) {
+            value_type& entry = entries[table[slot]];
+            if(entry.first.x == point.x && entry.first.z == point.z) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    const value_type* find(const MC_Point& point) const {
+        return const_cast<PointHashMap*>(this)->find(point);
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+private:
+    enum : uint32_t { EMPTY = UINT32_MAX };
+
+    //Elements, in insertion order
+    std::deque<value_type> entries;
+
+    //Open addressing table of indices into "entries". Size is a power of 2
+    std::vector<uint32_t> table;
+
+    //Pack x,z into 64 bits and mix them up (splitmix64 finalizer)
+    static size_t hash(const MC_Point& point) {
+        uint64_t h = (uint64_t(uint32_t(point.x)) << 32) | uint32_t(point.z);
+        h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return size_t(h);
+    }
+
+    void insertIndex(const MC_Point& point, size_t index) {
+        size_t mask = table.size() - 1;
+        size_t slot = hash(point) & mask;
+        while(table[slot] != EMPTY) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = index;
+    }
+
+    void rehash(size_t newSize) {
+        table.assign(newSize, EMPTY);
+        for(size_t i = 0; i != entries.size(); ++i) {
+            insertIndex(entries[i].first, i);
+        }
+    }
+};
+
+#endif
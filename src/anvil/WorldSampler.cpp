@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include "json11.hpp"
+#include "utility/utility.h"
+#include "anvil/nbtutility.h"
+#include "anvil/ChunkInterface.h"
+#include "anvil/ChunkSurface.h"
+#include "anvil/RegionFileWorld.h"
+#include "anvil/WorldSampler.h"
+#include "maginatics/threadpool/threadpool.h"
+
+namespace
+{
+
+//Number of distinct block ids (Blocks + Add nibble), heights and biome ids
+const unsigned idCount = 4096;
+const unsigned heightCount = 256;
+const unsigned heightBandSize = 16;
+const unsigned biomeCount = 256;
+
+//Blocks in a chunk, and in a chunk section
+const unsigned blocksPerChunk = 16*16*256;
+const unsigned blocksPerSection = 16*16*16;
+
+/* Per-category sums of each chunk's share, and of its square, over the
+ * sampled chunks. That's all the estimator needs, and tallies from
+ * different threads just add up */
+struct Tally
+{
+    std::vector<double> sum, sumSq;
+
+    Tally(unsigned categories) : sum(categories, 0.0), sumSq(categories, 0.0) { }
+
+    //Add one chunk, given its count in each category out of "total"
+    void add(const std::vector<unsigned>& counts, unsigned total)
+    {
+        for(unsigned i = 0; i != counts.size(); ++i) {
+            if(counts[i]) {
+                double share = double(counts[i]) / total;
+                sum[i] += share;
+                sumSq[i] += share * share;
+            }
+        }
+    }
+
+    void merge(const Tally& other)
+    {
+        for(unsigned i = 0; i != sum.size(); ++i) {
+            sum[i] += other.sum[i];
+            sumSq[i] += other.sumSq[i];
+        }
+    }
+};
+
+struct Tallies
+{
+    Tally blocks{idCount};
+    Tally heights{heightCount};
+    Tally heightBands{heightCount / heightBandSize};
+    Tally biomes{biomeCount};
+    Tally meanHeight{1};
+    uint64_t chunks = 0;
+    uint64_t failed = 0;
+
+    void merge(const Tallies& other)
+    {
+        blocks.merge(other.blocks);
+        heights.merge(other.heights);
+        heightBands.merge(other.heightBands);
+        biomes.merge(other.biomes);
+        meanHeight.merge(other.meanHeight);
+        chunks += other.chunks;
+        failed += other.failed;
+    }
+};
+
+/* Mean of "n" per-chunk values out of a population of "N" chunks, with the
+ * 95% interval from the between-chunk variance and the finite population
+ * correction. "clampShare" keeps the interval within 0-1. With a single
+ * chunk there's no variance to go on, so the interval is NaN */
+WorldSampler::Estimate estimate(unsigned key, double sum, double sumSq, double n, double N, bool clampShare)
+{
+    double mean = sum / n;
+    if(n < 2) {
+        return { key, mean, NAN, NAN };
+    }
+    double variance = std::max(0.0, (sumSq - n * mean * mean) / (n - 1));
+    double standardError = sqrt((1.0 - n / N) * variance / n);
+    double low = mean - 1.96 * standardError;
+    double high = mean + 1.96 * standardError;
+    if(clampShare) {
+        low = std::max(0.0, low);
+        high = std::min(1.0, high);
+    }
+    return { key, mean, low, high };
+}
+
+//Estimates of every category that showed up at all, optionally most common first
+std::vector<WorldSampler::Estimate> estimateAll(const Tally& tally, double n, double N, bool sortByShare)
+{
+    std::vector<WorldSampler::Estimate> result;
+    for(unsigned i = 0; i != tally.sum.size(); ++i) {
+        if(tally.sum[i] > 0) {
+            result.push_back(estimate(i, tally.sum[i], tally.sumSq[i], n, N, true));
+        }
+    }
+    if(sortByShare) {
+        std::sort(result.begin(), result.end(),
+            [](const WorldSampler::Estimate& a, const WorldSampler::Estimate& b) {
+                return a.share > b.share;
+            });
+    }
+    return result;
+}
+
+//Count every block in a chunk by id. Sections that aren't stored are all air
+void countBlocks(nbt_node* chunk, std::vector<unsigned>& counts)
+{
+    std::fill(counts.begin(), counts.end(), 0);
+
+    nbt_node* sections = nbt_find_by_path(chunk, ".Level.Sections");
+    unsigned stored = 0;
+    for(int y = 0; y != 16 && sections; ++y)
+    {
+        nbt_node* section = nbt_find(sections, nbtutil::predicates::findYSection, &y);
+        unsigned char* blocks = section ? nbtutil::getByteArray(section, "Blocks") : nullptr;
+        if(!blocks) {
+            continue;
+        }
+
+        //"Add" holds the upper 4 bits of each id, two blocks to a byte
+        unsigned char* add = nbtutil::getByteArray(section, "Add");
+        for(unsigned i = 0; i != blocksPerSection; ++i) {
+            unsigned id = blocks[i];
+            if(add) {
+                id |= ((add[i / 2] >> ((i % 2) * 4)) & 0xF) << 8;
+            }
+            counts[id]++;
+        }
+        stored++;
+    }
+
+    counts[0] += (16 - stored) * blocksPerSection;
+}
+
+//Tally one chunk. Returns false if it couldn't be read
+bool tallyChunk(RegionFile& region, int x, int z, Tallies& tallies, std::vector<unsigned>& counts)
+{
+    nbt_node* chunk = region.getChunkNBT(x, z);
+    if(!chunk) {
+        return false;
+    }
+
+    countBlocks(chunk, counts);
+    tallies.blocks.add(counts, blocksPerChunk);
+
+    ChunkInterface iface(chunk);
+    ChunkSurface surface;
+    surface.extract(iface);
+
+    std::vector<unsigned> heights(heightCount, 0);
+    std::vector<unsigned> heightBands(heightCount / heightBandSize, 0);
+    double heightSum = 0;
+    for(int cz = 0; cz != 16; ++cz)
+    for(int cx = 0; cx != 16; ++cx) {
+        uint8_t y = surface.getHeight(cx, cz);
+        heights[y]++;
+        heightBands[y / heightBandSize]++;
+        heightSum += y;
+    }
+    tallies.heights.add(heights, 256);
+    tallies.heightBands.add(heightBands, 256);
+
+    double meanHeight = heightSum / 256;
+    tallies.meanHeight.sum[0] += meanHeight;
+    tallies.meanHeight.sumSq[0] += meanHeight * meanHeight;
+
+    //Chunks saved before biomes existed don't have them; count them as unknown (255)
+    std::vector<unsigned> biomes(biomeCount, 0);
+    nbt_node* biomeNode = nbt_find_by_path(chunk, ".Level.Biomes");
+    if(biomeNode && biomeNode->type == TAG_BYTE_ARRAY && biomeNode->payload.tag_byte_array.length == 256) {
+        for(int i = 0; i != 256; ++i) {
+            biomes[biomeNode->payload.tag_byte_array.data[i]]++;
+        }
+    } else {
+        biomes[255] = 256;
+    }
+    tallies.biomes.add(biomes, 256);
+
+    tallies.chunks++;
+    return true;
+}
+
+}
+
+WorldSampler::WorldSampler(double fraction, unsigned threads, uint64_t seed)
+    : fraction(fraction)
+    , threads(std::max(1u, threads))
+    , seed(seed)
+{
+
+}
+
+WorldSampler::Results WorldSampler::sample(const std::string& worldPath)
+{
+    auto files = RegionFileWorld::findRegionFiles(worldPath);
+    if(files.empty()) {
+        error("No regions found in \"", worldPath, "\"");
+    }
+    std::vector<std::string> paths;
+    for(auto& file : files) {
+        paths.push_back(file.second);
+    }
+
+    /* Only the headers, to see which chunks exist, read on the pool. All that's
+     * kept of a chunk is where to find it: its region, index and first sector */
+    struct ChunkRef { uint32_t region; uint16_t index; uint32_t sector; };
+    std::vector<std::vector<ChunkRef>> found(paths.size());
+    std::string headerError;
+    std::mutex headerMutex;
+    {
+        maginatics::ThreadPool pool(1, threads, 30);
+        for(uint32_t r = 0; r != paths.size(); ++r)
+        {
+            pool.execute([&, r]() {
+                try {
+                    RegionFile region;
+                    region.loadHeader(paths[r]);
+                    for(uint16_t i = 0; i != 32*32; ++i) {
+                        if(region.hasChunk(i % 32, i / 32)) {
+                            found[r].push_back({ r, i, region.getChunkSector(i % 32, i / 32) });
+                        }
+                    }
+                }
+                catch(std::exception& ex) {
+                    std::lock_guard<std::mutex> lock(headerMutex);
+                    headerError = paths[r] + ": " + ex.what();
+                }
+            });
+        }
+        pool.drain();
+    }
+    if(!headerError.empty()) {
+        error(headerError);
+    }
+
+    std::vector<ChunkRef> population;
+    for(auto& refs : found) {
+        population.insert(population.end(), refs.begin(), refs.end());
+        std::vector<ChunkRef>().swap(refs);
+    }
+
+    Results results;
+    results.populationChunks = population.size();
+    if(population.empty()) {
+        error("No chunks found in \"", worldPath, "\"");
+    }
+
+    //A uniform sample without replacement: the front of a partial shuffle
+    size_t n = std::max<size_t>(1, size_t(ceil(fraction * population.size())));
+    n = std::min(n, population.size());
+    std::mt19937_64 random(seed ? seed : std::random_device()());
+    for(size_t i = 0; i != n; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, population.size() - 1);
+        std::swap(population[i], population[pick(random)]);
+    }
+    population.resize(n);
+
+    population.shrink_to_fit();
+
+    //Read each region's sampled chunks in file order, one region per task
+    std::sort(population.begin(), population.end(),
+        [](const ChunkRef& a, const ChunkRef& b) {
+            return a.region < b.region || (a.region == b.region && a.sector < b.sector);
+        });
+
+    Tallies total;
+    std::mutex totalMutex;
+    {
+        maginatics::ThreadPool pool(1, threads, 30);
+        size_t begin = 0;
+        while(begin != population.size())
+        {
+            size_t end = begin;
+            while(end != population.size() && population[end].region == population[begin].region) {
+                ++end;
+            }
+
+            pool.execute([&, begin, end]() {
+                Tallies tallies;
+                std::vector<unsigned> counts(idCount);
+
+                //Only regions with sampled chunks are opened again, one at a time per task
+                RegionFile region;
+                size_t first = begin;
+                try {
+                    region.loadHeader(paths[population[begin].region]);
+                }
+                catch(std::exception&) {
+                    tallies.failed += end - begin;
+                    first = end;
+                }
+
+                for(size_t i = first; i != end; ++i) {
+                    int x = population[i].index % 32, z = population[i].index / 32;
+                    try {
+                        if(!tallyChunk(region, x, z, tallies, counts)) {
+                            tallies.failed++;
+                        }
+                    }
+                    catch(std::exception&) {
+                        tallies.failed++;
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(totalMutex);
+                total.merge(tallies);
+            });
+
+            begin = end;
+        }
+        pool.drain();
+    }
+
+    results.sampledChunks = total.chunks;
+    results.failedChunks = total.failed;
+    if(total.chunks == 0) {
+        error("None of the ", n, " sampled chunks could be read");
+    }
+
+    /* Failed chunks are left out of the sample, as if they weren't picked.
+     * The population stays every chunk in the world */
+    double sampled = total.chunks, N = results.populationChunks;
+    results.blocks = estimateAll(total.blocks, sampled, N, true);
+    results.heights = estimateAll(total.heights, sampled, N, false);
+    results.heightBands = estimateAll(total.heightBands, sampled, N, false);
+    for(Estimate& e : results.heightBands) {
+        e.key *= heightBandSize;
+    }
+    results.biomes = estimateAll(total.biomes, sampled, N, true);
+    results.meanHeight = estimate(0, total.meanHeight.sum[0], total.meanHeight.sumSq[0], sampled, N, false);
+
+    return results;
+}
+
+void WorldSampler::print(const Results& results, unsigned limit)
+{
+    auto percent = [](double share) {
+        char text[16];
+        snprintf(text, sizeof(text), "%.3f%%", share * 100);
+        return std::string(text);
+    };
+    auto interval = [&](const Estimate& e) {
+        if(std::isnan(e.low)) {
+            return std::string("interval n/a");
+        }
+        return percent(e.low) + " - " + percent(e.high);
+    };
+    auto printList = [&](const char* title, const char* keyName, const std::vector<Estimate>& list) {
+        log(title);
+        for(unsigned i = 0; i != list.size() && i != limit; ++i) {
+            const Estimate& e = list[i];
+            log("  ", keyName, " ", e.key, ": ", percent(e.share), " (", interval(e), ")");
+        }
+    };
+
+    log("Sampled ", results.sampledChunks, " of ", results.populationChunks, " chunks (",
+        100.0 * results.sampledChunks / results.populationChunks, "%); ",
+        results.failedChunks, " could not be read. Intervals are 95%");
+
+    if(std::isnan(results.meanHeight.low)) {
+        log("Mean surface height: ", results.meanHeight.share, " (interval n/a)");
+    } else {
+        log("Mean surface height: ", results.meanHeight.share, " (", results.meanHeight.low,
+            " - ", results.meanHeight.high, ")");
+    }
+
+    printList("Blocks:", "id", results.blocks);
+    printList("Biomes:", "biome", results.biomes);
+
+    //Heights in 16 block bands, to keep it short
+    log("Surface heights:");
+    for(const Estimate& e : results.heightBands) {
+        log("  y ", e.key, "-", e.key + heightBandSize - 1, ": ", percent(e.share), " (", interval(e), ")");
+    }
+}
+
+void WorldSampler::saveJson(const Results& results, const std::string& filename)
+{
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        error("Could not open ", filename, " for writing statistics");
+    }
+
+    auto toJson = [](const std::vector<Estimate>& list) {
+        json11::Json::array array;
+        for(const Estimate& e : list) {
+            array.push_back(json11::Json::object{
+                {"key", int(e.key)}, {"share", e.share}, {"low", e.low}, {"high", e.high}
+            });
+        }
+        return array;
+    };
+
+    json11::Json::object root {
+        { "populationChunks", double(results.populationChunks) },
+        { "sampledChunks", double(results.sampledChunks) },
+        { "failedChunks", double(results.failedChunks) },
+        { "meanHeight", json11::Json::object{
+            {"value", results.meanHeight.share}, {"low", results.meanHeight.low}, {"high", results.meanHeight.high} } },
+        { "blocks", toJson(results.blocks) },
+        { "heights", toJson(results.heights) },
+        { "heightBands", toJson(results.heightBands) },
+        { "biomes", toJson(results.biomes) }
+    };
+
+    file << json11::Json(root).dump() << std::endl;
+}
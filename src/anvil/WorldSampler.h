@@ -0,0 +1,69 @@
+#ifndef WORLDSAMPLER_H
+#define WORLDSAMPLER_H
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "types.h"
+
+/* WorldSampler estimates world statistics from a random sample of chunks,
+ * instead of a census of every block. Only region headers are read to find
+ * the chunks that exist; a uniform random sample of those is then read and
+ * decoded, and nothing else.
+ *
+ * Chunks are the sampling unit, so each share is estimated as the mean of
+ * the per-chunk shares, with a standard error from the spread between
+ * chunks (which accounts for blocks in a chunk being alike) and the finite
+ * population correction (1 - n/N). Intervals are the normal 95% ones, and
+ * undefined (NaN) when fewer than two chunks could be sampled */
+
+class WorldSampler
+{
+public:
+    //An estimated share (0-1) with a 95% confidence interval (NaN bounds if unknown)
+    struct Estimate
+    {
+        unsigned key;       //What this is the share of: block id, height, biome id
+        double share;
+        double low, high;
+    };
+
+    struct Results
+    {
+        uint64_t populationChunks = 0;  //Chunks in the world (N)
+        uint64_t sampledChunks = 0;     //Chunks decoded (n)
+        uint64_t failedChunks = 0;      //Sampled, but wouldn't decode
+
+        //Share of all blocks (air included) by block id, most common first
+        std::vector<Estimate> blocks;
+        //Share of columns by surface height (the highest solid block's Y)
+        std::vector<Estimate> heights;
+        //Same in bands of 16 heights, keyed by the lowest Y of the band
+        std::vector<Estimate> heightBands;
+        //Share of columns by biome id, most common first
+        std::vector<Estimate> biomes;
+
+        //Mean surface height, with its 95% interval
+        Estimate meanHeight;
+    };
+
+public:
+    /* Sample "fraction" (0-1] of the chunks, decoding on "threads" threads.
+     * A "seed" of 0 seeds from the system's random device */
+    WorldSampler(double fraction, unsigned threads, uint64_t seed = 0);
+
+    //Sample the world at "worldPath". Throws if it has no regions
+    Results sample(const std::string& worldPath);
+
+    //Print results in a readable form, with the top "limit" of each list
+    static void print(const Results& results, unsigned limit = 20);
+
+    //Write all results as JSON, e.g. for a dashboard
+    static void saveJson(const Results& results, const std::string& filename);
+
+private:
+    double fraction;
+    unsigned threads;
+    uint64_t seed;
+};
+
+#endif
@@ -1,3 +1,7 @@
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+#include "utility/utility.h"
 #include "anvil/nbtutility.h"
 
 namespace nbtutil
@@ -38,3 +42,504 @@ int* getIntArray(nbt_node* src, const char* name)
 
 }
 
+
+/* Streaming inflate + parse
+ * ========================================================================= */
+
+namespace
+{
+
+//Tag type IDs, as in the NBT format
+enum : uint8_t {
+    NBT_END = 0, NBT_BYTE, NBT_SHORT, NBT_INT, NBT_LONG, NBT_FLOAT, NBT_DOUBLE,
+    NBT_BYTE_ARRAY, NBT_STRING, NBT_LIST, NBT_COMPOUND, NBT_INT_ARRAY, NBT_LONG_ARRAY
+};
+
+/* Cursor over a partly-inflated NBT buffer. Every read returns false if
+ * the data isn't there (yet), in which case the caller inflates more
+ * and picks up again from the last point it committed */
+struct Cursor
+{
+    const unsigned char* p;
+    const unsigned char* end;
+
+    bool has(size_t n) const {
+        return size_t(end - p) >= n;
+    }
+    size_t available() const {
+        return end - p;
+    }
+    bool readByte(uint8_t& out) {
+        if(!has(1)) return false;
+        out = *p++;
+        return true;
+    }
+    bool readShort(uint16_t& out) {
+        if(!has(2)) return false;
+        out = (uint16_t(p[0]) << 8) | p[1];
+        p += 2;
+        return true;
+    }
+    bool readInt(int32_t& out) {
+        if(!has(4)) return false;
+        out = int32_t((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]);
+        p += 4;
+        return true;
+    }
+    bool readName(std::string& out) {
+        uint16_t len;
+        if(!readShort(len) || !has(len)) return false;
+        out.assign((const char*)p, len);
+        p += len;
+        return true;
+    }
+};
+
+/* Skips one tag payload, a piece at a time. Nesting is kept on an explicit
+ * stack instead of the call stack, so when the data runs out halfway through
+ * (say, a large list of sections) the skip carries on from where it stopped
+ * once more is inflated, rather than starting over at the tag */
+class PayloadSkipper
+{
+public:
+    enum Result { FINISHED, NEED_MORE, INVALID };
+
+    void start(uint8_t type) {
+        stack.assign(1, Frame{Frame::PAYLOAD, type, 0});
+    }
+
+    /* Skip as much as the cursor holds. The cursor only ever stops
+     * between whole pieces, so it can be committed whatever the result */
+    Result advance(Cursor& c)
+    {
+        while(!stack.empty())
+        {
+            Frame& top = stack.back();
+            switch(top.kind)
+            {
+            case Frame::PAYLOAD:
+                if(!startPayload(c, top)) {
+                    return top.kind == Frame::INVALID ? INVALID : NEED_MORE;
+                }
+                break;
+
+            case Frame::BYTES: {
+                size_t n = std::min<size_t>(top.remaining, c.available());
+                c.p += n;
+                top.remaining -= n;
+                if(top.remaining) return NEED_MORE;
+                stack.pop_back();
+                break;
+            }
+
+            case Frame::LIST_ITEMS:
+                if(!top.remaining) {
+                    stack.pop_back();
+                    break;
+                }
+                top.remaining--;
+                stack.push_back(Frame{Frame::PAYLOAD, top.type, 0});
+                break;
+
+            case Frame::COMPOUND_ITEMS: {
+                Cursor peek = c;
+                uint8_t childType;
+                uint16_t len;
+                if(!peek.readByte(childType)) return NEED_MORE;
+                if(childType == NBT_END) {
+                    c = peek;
+                    stack.pop_back();
+                    break;
+                }
+                if(!peek.readShort(len) || !peek.has(len)) return NEED_MORE;
+                peek.p += len;
+                c = peek;
+                stack.push_back(Frame{Frame::PAYLOAD, childType, 0});
+                break;
+            }
+
+            case Frame::INVALID:
+                return INVALID;
+            }
+        }
+        return FINISHED;
+    }
+
+private:
+    struct Frame
+    {
+        enum Kind { PAYLOAD, BYTES, LIST_ITEMS, COMPOUND_ITEMS, INVALID } kind;
+        uint8_t type;       //Payload type, or element type of a list
+        uint64_t remaining; //Bytes or list elements left
+    };
+    std::vector<Frame> stack;
+
+    /* Turn a payload not yet started into what's left to skip of it.
+     * Returns false if its length prefix isn't inflated yet, or if the
+     * type is unknown (the frame is marked INVALID) */
+    static bool startPayload(Cursor& c, Frame& frame)
+    {
+        int32_t count;
+        uint16_t len;
+        uint8_t elementType;
+        switch(frame.type)
+        {
+        case NBT_BYTE:   frame = Frame{Frame::BYTES, 0, 1}; return true;
+        case NBT_SHORT:  frame = Frame{Frame::BYTES, 0, 2}; return true;
+        case NBT_INT:    frame = Frame{Frame::BYTES, 0, 4}; return true;
+        case NBT_LONG:   frame = Frame{Frame::BYTES, 0, 8}; return true;
+        case NBT_FLOAT:  frame = Frame{Frame::BYTES, 0, 4}; return true;
+        case NBT_DOUBLE: frame = Frame{Frame::BYTES, 0, 8}; return true;
+        case NBT_BYTE_ARRAY:
+        case NBT_INT_ARRAY:
+        case NBT_LONG_ARRAY: {
+            if(!c.has(4)) return false;
+            c.readInt(count);
+            if(count < 0) break;
+            size_t elementSize = frame.type == NBT_BYTE_ARRAY ? 1 : frame.type == NBT_INT_ARRAY ? 4 : 8;
+            frame = Frame{Frame::BYTES, 0, uint64_t(count) * elementSize};
+            return true;
+        }
+        case NBT_STRING:
+            if(!c.readShort(len)) return false;
+            frame = Frame{Frame::BYTES, 0, len};
+            return true;
+        case NBT_LIST: {
+            if(!c.has(5)) return false;
+            c.readByte(elementType);
+            c.readInt(count);
+            if(count < 0) break;
+            frame = Frame{Frame::LIST_ITEMS, elementType, uint64_t(count)};
+            return true;
+        }
+        case NBT_COMPOUND:
+            frame = Frame{Frame::COMPOUND_ITEMS, 0, 0};
+            return true;
+        default:
+            break;
+        }
+        //Unknown tag or bad length; can't go on
+        frame.kind = Frame::INVALID;
+        return false;
+    }
+};
+
+/* Where the scan of the chunk is at. Scanning only moves forward, and
+ * every byte of inflated data is looked at once, so it can be resumed
+ * as more data is inflated */
+struct ChunkScan
+{
+    enum { ROOT_HEADER, ROOT_CHILDREN, LEVEL_CHILDREN, SKIPPING, DONE } state = ROOT_HEADER;
+
+    //Offset of the next byte to scan
+    size_t pos = 0;
+
+    //Level tags we're still waiting on
+    std::vector<std::string> wanted;
+
+    //While SKIPPING: the tag being skipped, its name, and the state to return to
+    PayloadSkipper skipper;
+    std::string skippedName;
+    decltype(state) skippedIn = ROOT_CHILDREN;
+
+    /* Scan as far as the inflated data allows. Returns true once every
+     * wanted tag has been read, with "pos" just past the last of them */
+    bool advance(const std::vector<unsigned char>& buffer, size_t size)
+    {
+        Cursor c{ buffer.data() + pos, buffer.data() + size };
+
+        while(state != DONE)
+        {
+            if(state == SKIPPING) {
+                PayloadSkipper::Result result = skipper.advance(c);
+                pos = c.p - buffer.data();
+                if(result == PayloadSkipper::INVALID) {
+                    //Can't tell where the tag ends; it will be parsed in full
+                    state = DONE;
+                    return false;
+                }
+                if(result == PayloadSkipper::NEED_MORE) {
+                    return false;
+                }
+
+                state = skippedIn;
+                if(state == LEVEL_CHILDREN) {
+                    auto it = std::find(wanted.begin(), wanted.end(), skippedName);
+                    if(it != wanted.end()) {
+                        wanted.erase(it);
+                    }
+                    if(wanted.empty()) {
+                        state = DONE;
+                        return true;
+                    }
+                }
+                continue;
+            }
+
+            //Tag headers are small, so they're read whole or not at all
+            uint8_t type;
+            std::string name;
+            if(!c.readByte(type)) return false;
+
+            if(state == ROOT_HEADER) {
+                if(type != NBT_COMPOUND) {
+                    //Not a chunk we understand; it will be parsed in full
+                    state = DONE;
+                    return false;
+                }
+                if(!c.readName(name)) return false;
+                state = ROOT_CHILDREN;
+            }
+            else if(type == NBT_END) {
+                //Ran out of tags before seeing everything
+                state = DONE;
+                return false;
+            }
+            else {
+                if(!c.readName(name)) return false;
+
+                if(state == ROOT_CHILDREN && type == NBT_COMPOUND && name == "Level") {
+                    state = LEVEL_CHILDREN;
+                }
+                else {
+                    skipper.start(type);
+                    skippedName = name;
+                    skippedIn = state;
+                    state = SKIPPING;
+                }
+            }
+
+            //Trust everything up to here; resume from this point next time
+            pos = c.p - buffer.data();
+        }
+        return false;
+    }
+};
+
+}
+
+/* Parsing in steps
+ * ========================================================================= */
+
+namespace
+{
+
+//Roughly how much of a chunk to parse between deadline checks
+const size_t parseStep = 64 * 1024;
+
+/* A whole (inflated) chunk split up for parsing in steps: the chunk with
+ * an empty "Level", and where each tag under "Level" is */
+struct ChunkLayout
+{
+    std::vector<unsigned char> skeleton;
+    std::vector<std::pair<size_t, size_t>> levelTags; //Offset and length
+};
+
+/* Lay out the chunk in "data", checking "deadline" after each tag under "Level".
+ * Returns false if it isn't a compound with a "Level" compound in it */
+bool layoutChunk(const unsigned char* data, size_t size, ChunkLayout& layout, const Deadline& deadline)
+{
+    Cursor c{ data, data + size };
+    PayloadSkipper skipper;
+    uint8_t type;
+    std::string name;
+    bool sawLevel = false;
+
+    if(!c.readByte(type) || type != NBT_COMPOUND || !c.readName(name)) {
+        return false;
+    }
+    layout.skeleton.assign(data, c.p);
+
+    for(;;)
+    {
+        const unsigned char* tagStart = c.p;
+        if(!c.readByte(type)) return false;
+        if(type == NBT_END) break;
+        if(!c.readName(name)) return false;
+
+        //Level itself goes in the skeleton, but none of what's under it
+        if(!sawLevel && type == NBT_COMPOUND && name == "Level")
+        {
+            sawLevel = true;
+            layout.skeleton.insert(layout.skeleton.end(), tagStart, c.p);
+            for(;;)
+            {
+                const unsigned char* childStart = c.p;
+                if(!c.readByte(type)) return false;
+                if(type == NBT_END) break;
+                if(!c.readName(name)) return false;
+
+                skipper.start(type);
+                if(skipper.advance(c) != PayloadSkipper::FINISHED) return false;
+                layout.levelTags.push_back({ size_t(childStart - data), size_t(c.p - childStart) });
+                deadline.check("Parsing chunk");
+            }
+            layout.skeleton.push_back(NBT_END);
+            continue;
+        }
+
+        skipper.start(type);
+        if(skipper.advance(c) != PayloadSkipper::FINISHED) return false;
+        layout.skeleton.insert(layout.skeleton.end(), tagStart, c.p);
+    }
+
+    layout.skeleton.push_back(NBT_END);
+    return sawLevel;
+}
+
+//The compound directly under "parent" named "name", or nullptr
+nbt_node* childCompound(nbt_node* parent, const char* name)
+{
+    struct list_head* pos;
+    list_for_each(pos, &parent->payload.tag_compound->entry) {
+        nbt_node* child = list_entry(pos, struct nbt_list, entry)->data;
+        if(child->type == TAG_COMPOUND && child->name && strcmp(child->name, name) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+//Move every tag of compound "from" to the end of compound "to"
+void moveTags(nbt_node* from, nbt_node* to)
+{
+    struct list_head* pos;
+    struct list_head* next;
+    list_for_each_safe(pos, next, &from->payload.tag_compound->entry) {
+        list_del(pos);
+        list_add_tail(pos, &to->payload.tag_compound->entry);
+    }
+}
+
+/* Parse a whole chunk a few tags at a time, so a deadline can stop it part
+ * way through: first everything but what's under "Level", then the tags
+ * under "Level" in batches of about parseStep bytes, each moved into the
+ * tree as it's parsed. A single tag is never split, so a step can run
+ * over for a tag much bigger than parseStep. Chunks laid out differently
+ * are parsed in one go. Returns nullptr if the data is corrupt */
+nbt_node* parseInSteps(const unsigned char* data, size_t size, const Deadline& deadline)
+{
+    ChunkLayout layout;
+    if(!layoutChunk(data, size, layout, deadline)) {
+        deadline.check("Parsing chunk");
+        return nbt_parse(data, size);
+    }
+
+    nbt_node* root = nbt_parse(layout.skeleton.data(), layout.skeleton.size());
+    nbt_node* level = root ? childCompound(root, "Level") : nullptr;
+    if(!level) {
+        if(root) {
+            nbt_free(root);
+        }
+        return nullptr;
+    }
+
+    std::vector<unsigned char> batch;
+    size_t next = 0;
+    while(next != layout.levelTags.size())
+    {
+        if(deadline.expired()) {
+            nbt_free(root);
+            deadline.check("Parsing chunk");
+        }
+
+        //An unnamed compound holding the next few tags
+        batch.assign({ NBT_COMPOUND, 0, 0 });
+        do {
+            const auto& tag = layout.levelTags[next++];
+            batch.insert(batch.end(), data + tag.first, data + tag.first + tag.second);
+        } while(next != layout.levelTags.size() && batch.size() + layout.levelTags[next].second <= parseStep);
+        batch.push_back(NBT_END);
+
+        nbt_node* part = nbt_parse(batch.data(), batch.size());
+        if(!part) {
+            nbt_free(root);
+            return nullptr;
+        }
+        moveTags(part, level);
+        nbt_free(part);
+    }
+
+    if(deadline.expired()) {
+        nbt_free(root);
+        deadline.check("Parsing chunk");
+    }
+    return root;
+}
+
+}
+
+namespace nbtutil
+{
+
+nbt_node* parseCompressedUntil(const void* data, size_t length,
+                               const std::vector<std::string>& levelTags,
+                               size_t* skipped, const Deadline& deadline)
+{
+    //How much to inflate between scans
+    const size_t step = 16 * 1024;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof stream);
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = length;
+
+    //15 + 32: zlib or gzip header, detected automatically
+    if(inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return nullptr;
+    }
+
+    ChunkScan scan;
+    scan.wanted = levelTags;
+    bool complete = levelTags.empty();
+
+    std::vector<unsigned char> buffer;
+    size_t size = 0;
+    int result = Z_OK;
+
+    while(result != Z_STREAM_END)
+    {
+        if(deadline.expired()) {
+            inflateEnd(&stream);
+            deadline.check("Inflating chunk");
+        }
+
+        buffer.resize(size + step);
+        stream.next_out = buffer.data() + size;
+        stream.avail_out = step;
+
+        result = inflate(&stream, Z_NO_FLUSH);
+        size = buffer.size() - stream.avail_out;
+
+        if(result != Z_OK && result != Z_STREAM_END) {
+            inflateEnd(&stream);
+            return nullptr;
+        }
+
+        if(!complete && scan.advance(buffer, size)) {
+            complete = true;
+            break;
+        }
+    }
+
+    if(skipped) {
+        *skipped = stream.avail_in;
+    }
+    inflateEnd(&stream);
+
+    //Stopped early: close the Level and root compounds after the last tag read
+    if(complete && result != Z_STREAM_END) {
+        size = scan.pos;
+        buffer.resize(size + 2);
+        buffer[size++] = NBT_END;
+        buffer[size++] = NBT_END;
+    }
+
+    //With a deadline, parse in steps so it's checked along the way too
+    if(deadline.isLimited()) {
+        return parseInSteps(buffer.data(), size, deadline);
+    }
+    return nbt_parse(buffer.data(), size);
+}
+
+}
@@ -1,6 +1,10 @@
 #ifndef NBTUTILITY_H
 #define NBTUTILITY_H
+#include <string>
+#include <vector>
+#include <stddef.h>
 #include <nbt/nbt.h>
+#include "utility/deadline.h"
 
 namespace nbtutil 
 {
@@ -19,6 +23,23 @@ bool findYSection(const nbt_node* node, void* aux);
 unsigned char* getByteArray(nbt_node* src, const char* name);
 int* getIntArray(nbt_node* src, const char* name);
 
+/* Inflate and parse a compressed (zlib or gzip) chunk, stopping early.
+ * The data is inflated a piece at a time and scanned as it arrives; as soon
+ * as every tag named in "levelTags" has been read in full under the
+ * root's "Level" compound, inflating stops and only what was read so far is
+ * parsed (the tree is closed off after the last tag read). Tags that come
+ * later in the chunk, such as large Entities lists, are never inflated.
+ * If a tag never shows up, the whole chunk is parsed as usual.
+ *
+ * "skipped" is set to the number of compressed bytes that were not inflated.
+ * With a limited "deadline", the inflated chunk is also parsed a few tags at a
+ * time, and the deadline is checked between inflate and parse steps.
+ * Returns nullptr if the data is corrupt. Throws if "deadline" expires. */
+nbt_node* parseCompressedUntil(const void* data, size_t length,
+                               const std::vector<std::string>& levelTags,
+                               size_t* skipped = nullptr,
+                               const Deadline& deadline = Deadline());
+
 }
 
 #endif
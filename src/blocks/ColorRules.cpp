@@ -0,0 +1,196 @@
+#include <fstream>
+#include <set>
+#include "utility/utility.h"
+#include "blocks/ColorRules.h"
+
+namespace
+{
+
+//Parse "n", "n-m" or "*" into low/high, where * is [low, high] as passed in
+void parseRange(const std::string& text, unsigned& low, unsigned& high)
+{
+    if(text == "*") {
+        return;
+    }
+
+    size_t dash = text.find('-');
+    low = std::stoul(text.substr(0, dash));
+    high = (dash == std::string::npos) ? low : std::stoul(text.substr(dash+1));
+    if(high < low) {
+        error("Range \"", text, "\" is backwards");
+    }
+}
+
+//Parse "#RRGGBB" or "#RRGGBBAA"
+image::Color parseColor(const std::string& text)
+{
+    if(text.size() != 7 && text.size() != 9) {
+        error("Color \"", text, "\" should be #RRGGBB or #RRGGBBAA");
+    }
+
+    uint32_t value = std::stoul(text.substr(1), nullptr, 16);
+    if(text.size() == 7) {
+        value = (value << 8) | image::ALPHA_OPAQUE;
+    }
+    return image::unpackRGBA(value);
+}
+
+}
+
+namespace blocks
+{
+
+void ColorRules::load(const std::string& filename, const BlockColors& base)
+{
+    std::ifstream file(filename);
+    if(!file.is_open()) {
+        error("Could not open color rules \"", filename, "\"");
+    }
+
+    std::vector<Rule> rules;
+    std::string line;
+    for(int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        //Remove comments and surrounding whitespace
+        line = line.substr(0, line.find(';'));
+        trim(line);
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        rules.push_back(parseRule(line, lineNumber));
+    }
+
+    compile(rules, base);
+    log("Loaded ", rules.size(), " color rule(s) from \"", filename, "\" into ",
+        bandTables.size(), " height band(s)");
+}
+
+image::Color ColorRules::getColor(uint16_t packed, uint8_t y) const
+{
+    return bandTables[bandOfHeight[y]][packed];
+}
+
+ColorRules::Rule ColorRules::parseRule(const std::string& line, int lineNumber) const
+{
+    Rule rule;
+    try {
+        std::vector<std::string> words = Split(line, " \t");
+        if(words.size() < 2) {
+            error("expected \"<ids> <action> ...\"");
+        }
+
+        //<ids>[:<metas>]
+        size_t colon = words[0].find(':');
+        parseRange(words[0].substr(0, colon), rule.idLow, rule.idHigh);
+        if(colon != std::string::npos) {
+            parseRange(words[0].substr(colon+1), rule.metaLow, rule.metaHigh);
+        }
+        if(rule.idHigh > 4095 || rule.metaHigh > 15) {
+            error("ids go up to 4095 and metas up to 15");
+        }
+
+        //<action>
+        const std::string& action = words[1];
+        if(action == "color")      rule.action = Rule::COLOR;
+        else if(action == "blend") rule.action = Rule::BLEND;
+        else if(action == "keep")  rule.action = Rule::KEEP;
+        else error("unknown action \"", action, "\"");
+
+        //The rest, in any order: color, percent, height range
+        bool hasColor = false;
+        for(size_t i = 2; i < words.size(); ++i)
+        {
+            const std::string& word = words[i];
+            if(word[0] == '#') {
+                rule.color = parseColor(word);
+                hasColor = true;
+            }
+            else if(word.back() == '%') {
+                rule.percent = std::min(100ul, std::stoul(word));
+            }
+            else if(word.compare(0, 2, "y=") == 0) {
+                unsigned low = 0, high = 255;
+                parseRange(word.substr(2), low, high);
+                rule.yLow = std::min(255u, low);
+                rule.yHigh = std::min(255u, high);
+            }
+            else {
+                error("don't know what \"", word, "\" is");
+            }
+        }
+
+        if(rule.action != Rule::KEEP && !hasColor) {
+            error("\"", action, "\" needs a color");
+        }
+    }
+    catch(std::logic_error& ex) { //std::stoul failures
+        error("Color rule line ", lineNumber, ": bad number (", ex.what(), ")");
+    }
+    catch(std::exception& ex) {
+        error("Color rule line ", lineNumber, ": ", ex.what());
+    }
+    return rule;
+}
+
+void ColorRules::compile(const std::vector<Rule>& rules, const BlockColors& base)
+{
+    //Every height where some rule starts or stops applying begins a new band
+    std::set<int> bandStarts = { 0 };
+    for(const Rule& rule : rules) {
+        bandStarts.insert(rule.yLow);
+        if(rule.yHigh < 255) {
+            bandStarts.insert(rule.yHigh + 1);
+        }
+    }
+
+    const std::vector<image::Color>& baseTable = base.getColorTable();
+    bandTables.clear();
+
+    for(auto it = bandStarts.begin(); it != bandStarts.end(); ++it)
+    {
+        int low = *it;
+        int high = (std::next(it) == bandStarts.end()) ? 255 : *std::next(it) - 1;
+
+        for(int y = low; y <= high; ++y) {
+            bandOfHeight[y] = bandTables.size();
+        }
+
+        //Start from the normal colors, then apply each rule in order
+        std::vector<image::Color> table = baseTable;
+        for(const Rule& rule : rules)
+        {
+            if(low < rule.yLow || low > rule.yHigh) {
+                continue;
+            }
+
+            for(unsigned id = rule.idLow; id <= rule.idHigh; ++id)
+            for(unsigned meta = rule.metaLow; meta <= rule.metaHigh; ++meta)
+            {
+                unsigned index = (id << 4) | meta;
+                image::Color own = baseTable[index];
+                image::Color& out = table[index];
+
+                switch(rule.action)
+                {
+                case Rule::COLOR:
+                    out = rule.color;
+                    break;
+                case Rule::KEEP:
+                    out = own;
+                    break;
+                case Rule::BLEND:
+                    out.r = (own.r * (100 - rule.percent) + rule.color.r * rule.percent) / 100;
+                    out.g = (own.g * (100 - rule.percent) + rule.color.g * rule.percent) / 100;
+                    out.b = (own.b * (100 - rule.percent) + rule.color.b * rule.percent) / 100;
+                    out.a = own.a;
+                    break;
+                }
+            }
+        }
+
+        bandTables.push_back(std::move(table));
+    }
+}
+
+}
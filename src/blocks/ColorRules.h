@@ -0,0 +1,66 @@
+#ifndef COLORRULES_H
+#define COLORRULES_H
+#include <array>
+#include <string>
+#include <vector>
+#include "blocks/blocks.h"
+
+/* ColorRules loads a rule file for custom maps ("highlight ores, grey
+ * out everything else") and compiles it into flat color tables, the same
+ * 4096x16 layout as BlockColors::getColorTable. Drawing with rules is then
+ * a table lookup, with no per-pixel rule matching.
+ *
+ * Rule file format, one rule per line, later rules winning:
+ *
+ *     <ids>[:<metas>]  <action>  [#RRGGBB[AA]]  [<percent>%]  [y=<low>-<high>]
+ *
+ *   ids/metas  A number, a range like 14-16, or * for all
+ *   action     color  - use the given color
+ *              blend  - mix the block's own color with the given color by
+ *                       <percent> (default 50%)
+ *              keep   - use the block's own color
+ *   y=         Only apply to blocks whose height is in this range
+ *
+ * Anything after a ; is a comment, as are lines starting with #. For example:
+ *
+ *     *        blend #808080 80%    ;grey out everything
+ *     14-16    color #FF0000        ;gold, iron and coal ore in red
+ *     56       color #00FFFF y=0-16 ;diamond ore, only near bedrock
+ */
+
+namespace blocks
+{
+
+class ColorRules
+{
+public:
+    /* Read rules from "filename" and compile them on top of the colors in
+     * "base". Throws on a malformed rule */
+    void load(const std::string& filename, const BlockColors& base);
+
+    //Color for a block packed as (id << 4) | meta, at height y
+    image::Color getColor(uint16_t packed, uint8_t y) const;
+
+private:
+    struct Rule
+    {
+        enum Action { COLOR, BLEND, KEEP } action = COLOR;
+        unsigned idLow = 0, idHigh = 4095;
+        unsigned metaLow = 0, metaHigh = 15;
+        int yLow = 0, yHigh = 255;
+        image::Color color;
+        unsigned percent = 50;
+    };
+
+    /* Heights are split into bands where the same rules apply; each band
+     * gets its own compiled table. Without height rules there's one band */
+    std::array<uint8_t, 256> bandOfHeight;
+    std::vector<std::vector<image::Color>> bandTables;
+
+    Rule parseRule(const std::string& line, int lineNumber) const;
+    void compile(const std::vector<Rule>& rules, const BlockColors& base);
+};
+
+}
+
+#endif
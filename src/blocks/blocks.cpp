@@ -1,4 +1,6 @@
+#include <stdio.h>
 #include <fstream>
+#include <algorithm>
 #include "json11.hpp"
 #include "ZipLib/ZipFile.h"
 #include "utility/lodepng.h"
@@ -9,14 +11,14 @@ namespace
 {
 
 /* This is a std::map comparison functor that returns
- * true if two SDL_Colors are similar. By doing this,
+ * true if two colors are similar. By doing this,
  * similar colors can be grouped together */
 
 struct SimilarColorCompare
 {
     static const int tol = 20;
 
-    bool operator()(const SDL_Color& a, const SDL_Color& b)
+    bool operator()(const image::Color& a, const image::Color& b)
     {
         return (abs(a.r-b.r) < tol) && (abs(a.g-b.g) < tol) && (abs(a.b-b.b) < tol);
     }
@@ -79,16 +81,6 @@ BlockID::operator std::string() const
 namespace blocks
 {
 
-BlockColors::BlockColors()
-{
-    rgba = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
-}
-
-BlockColors::~BlockColors()
-{
-    SDL_FreeFormat(rgba);
-}
-
 void BlockColors::load(const std::string& zipFileName, const std::string& cacheFileName)
 {
     using namespace json11;
@@ -132,11 +124,11 @@ void BlockColors::load(const std::string& zipFileName, const std::string& cacheF
             key = cacheJson[nameWithMeta];
         }
 
-        SDL_Color blockColor;
+        image::Color blockColor;
 
         if(key.is_object() && (unsigned)key["crc"].int_value() == zipcrc) {
-            Uint32 cachePixel = key["color"].int_value();
-            SDL_GetRGBA(cachePixel, rgba, &blockColor.r, &blockColor.g, &blockColor.b, &blockColor.a);
+            uint32_t cachePixel = key["color"].int_value();
+            blockColor = image::unpackRGBA(cachePixel);
         } else {
             blockColor = computeColor(entry);
             hadToRecompute = true;
@@ -150,14 +142,27 @@ void BlockColors::load(const std::string& zipFileName, const std::string& cacheF
     if(hadToRecompute) {
         saveNewJsonCache();
     }
+
+    buildColorTable();
+    loaded = true;
 }
 
 bool BlockColors::isLoaded() const
 {
-    return isLoaded();
+    return loaded;
 }
 
-SDL_Color BlockColors::computeColor(const ZipArchiveEntry::Ptr& blockImage)
+void BlockColors::buildColorTable()
+{
+    //Resolve every id/meta once, including the meta 0 and unknown fallbacks
+    colorTable.resize(colorTableSize);
+    for(unsigned id = 0; id != 4096; ++id)
+    for(unsigned meta = 0; meta != 16; ++meta) {
+        colorTable[(id << 4) | meta] = getBlockColor(id, meta);
+    }
+}
+
+image::Color BlockColors::computeColor(const ZipArchiveEntry::Ptr& blockImage)
 {
     /* computeColor method: For each non-transparent pixel,
      * count the number of times the pixel color has appeared, grouping
@@ -171,20 +176,20 @@ SDL_Color BlockColors::computeColor(const ZipArchiveEntry::Ptr& blockImage)
 
     /* A map of {color -> use counts}. By using SimilarColorCompare as the comparison, 
      * similar colors are said to be equal, "averaging" the colors */
-    std::map<SDL_Color, unsigned, SimilarColorCompare> colorCounts;
+    std::map<image::Color, unsigned, SimilarColorCompare> colorCounts;
 
     /* Record non-transparent colors. The recorded color is the RGA value with 255 alpha
      * To prevent solid blocks like grass having transparency because the
      * first zero-alpha pixel being not 255 alpha */
     for(unsigned i = 0; i != pixels.size(); i += 4)
     {
-        Uint8 r, g, b, a;
+        uint8_t r, g, b, a;
         r = pixels[i+0];
         g = pixels[i+1];
         b = pixels[i+2];
         a = pixels[i+3];
-        if(a != SDL_ALPHA_TRANSPARENT) {
-            colorCounts[ SDL_Color{r, g, b, SDL_ALPHA_OPAQUE} ] += 1;
+        if(a != image::ALPHA_TRANSPARENT) {
+            colorCounts[ image::Color{r, g, b, image::ALPHA_OPAQUE} ] += 1;
         }
     }
 
@@ -224,9 +229,9 @@ void BlockColors::saveNewJsonCache() const
         const auto& value = pair.second;
 
         //Convience
-        SDL_Color color = value.first;
+        image::Color color = value.first;
         unsigned crc = value.second;
-        Uint32 pixel = SDL_MapRGBA(rgba, color.r, color.g, color.b, color.a);
+        uint32_t pixel = image::packRGBA(color);
 
         root.insert(
             { id, json11::Json::object{{"crc",(int)crc}, {"color",(int)pixel}} }
@@ -238,12 +243,49 @@ void BlockColors::saveNewJsonCache() const
     file.close();
 }
 
-SDL_Color BlockColors::getBlockColor(unsigned id, unsigned meta) const
+void BlockColors::savePalette(const std::string& filename, uint8_t quarantinedAlpha) const
+{
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        error("Could not open ", filename, " for writing the palette");
+    }
+
+    auto toHex = [](const image::Color& color) {
+        char hex[10];
+        snprintf(hex, sizeof(hex), "#%08x", image::packRGBA(color));
+        return std::string(hex);
+    };
+
+    json11::Json::object blocks;
+    for(const auto& pair : blockColors) {
+        blocks.insert({ std::string(pair.first), toHex(pair.second.first) });
+    }
+
+    json11::Json::object root {
+        { "unknown", toHex(getBlockColor(invalidID.id, 0)) },
+        { "quarantinedAlpha", int(quarantinedAlpha) },
+        { "blocks", blocks }
+    };
+
+    file << json11::Json(root).dump() << std::endl;
+}
+
+image::Color BlockColors::getBlockColor(unsigned id, unsigned meta) const
 {
     return getBlockColor(BlockID{id,meta});
 }
 
-SDL_Color BlockColors::getBlockColor(const BlockID& blockid) const
+image::Color BlockColors::getPackedColor(uint16_t packed) const
+{
+    return colorTable[packed];
+}
+
+const std::vector<image::Color>& BlockColors::getColorTable() const
+{
+    return colorTable;
+}
+
+image::Color BlockColors::getBlockColor(const BlockID& blockid) const
 {
     auto it = blockColors.find(blockid);
 
@@ -253,7 +295,7 @@ SDL_Color BlockColors::getBlockColor(const BlockID& blockid) const
         /* Base recursive case, if meta 0 isn't found, we safely
          * say we don't know the block */
         if(blockid.meta == 0) {
-            return SDL_Color{255, 20, 147, 255}; //Unknown color
+            return image::Color{255, 20, 147, 255}; //Unknown color
         }
 
         /* If not found, check if we have the block with no metadata.
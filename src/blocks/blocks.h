@@ -1,8 +1,10 @@
 #ifndef BLOCKS_H
 #define BLOCKS_H
-#include <SDL2/SDL.h>
+#include <climits>
 #include <string>
+#include <vector>
 #include <map>
+#include "image/Color.h"
 #include "ZipLib/ZipArchiveEntry.h"
 
 /* Routines to handle returning RGB values for
@@ -49,8 +51,7 @@ static const BlockID invalidID = {UINT_MAX, UINT_MAX};
 class BlockColors
 {
 public:
-    BlockColors();
-   ~BlockColors();
+    BlockColors() = default;
     BlockColors(const BlockColors&) = delete;
 
     /* Open the block .png zip from a file
@@ -62,8 +63,24 @@ public:
 
     /* Return a color for a block. This is based off of the
      * png for its ID */
-    SDL_Color getBlockColor(unsigned id, unsigned meta = 0) const;
-    SDL_Color getBlockColor(const BlockID& blockid) const;
+    image::Color getBlockColor(unsigned id, unsigned meta = 0) const;
+    image::Color getBlockColor(const BlockID& blockid) const;
+
+    /* Same as above, for a block packed as (id << 4) | meta (see ChunkSurface).
+     * This is a single lookup in a flat table, built when loading */
+    image::Color getPackedColor(uint16_t packed) const;
+
+    /* The flat table itself: colorTableSize colors, indexed by (id << 4) | meta.
+     * Metadata without its own color already falls back to meta 0 here */
+    const std::vector<image::Color>& getColorTable() const;
+    static const unsigned colorTableSize = 4096 * 16;
+
+    /* Write the colors as a JSON palette for clients drawing data tiles
+     * (see DataDrawer): "blocks" maps "id-meta" to "#rrggbbaa", and
+     * "unknown" is the color of blocks not listed. As with getBlockColor,
+     * a block whose meta isn't listed takes the color of meta 0.
+     * "quarantinedAlpha" is the alpha of pixels in chunks that could not be drawn */
+    void savePalette(const std::string& filename, uint8_t quarantinedAlpha) const;
 
     /* If we have valid .zip data or not */
     bool isLoaded() const;
@@ -73,24 +90,24 @@ private:
     std::string zipFileName, cacheFileName;
 
     //See isLoaded()
-    bool loaded;
-
-    //SDL Pixel format for converting pixels to RGBA values and back;
-    //is always SDL_PIXELFORMAT_RGBA8888
-    SDL_PixelFormat* rgba;
+    bool loaded = false;
 
     //Read a ZipArchiveEntry::Ptr into bytes
     std::vector<char> readZipEntry(const ZipArchiveEntry::Ptr& blockImage);
 
     //Give us a single color for a block from the .zip
-    SDL_Color computeColor(const ZipArchiveEntry::Ptr& blockImage);
+    image::Color computeColor(const ZipArchiveEntry::Ptr& blockImage);
 
     //Writes out a new JSON cache, in case of computeColor being used
     void saveNewJsonCache() const;
 
     //Map of a blockID -> {color, .zip CRC32}
     //The CRC is the hash of the png used to generated the color.
-    std::map<BlockID, std::pair<SDL_Color, unsigned>> blockColors;
+    std::map<BlockID, std::pair<image::Color, unsigned>> blockColors;
+
+    //Every id/meta's color, resolved from blockColors. See getColorTable()
+    std::vector<image::Color> colorTable;
+    void buildColorTable();
 };
 
 }
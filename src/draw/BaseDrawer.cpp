@@ -1,96 +1,482 @@
-#include <SDL2/SDL.h>
+#include <functional>
+#include <algorithm>
 #include "blocks/blocks.h"
 #include "anvil/ChunkInterface.h"
 #include "utility/utility.h"
 #include "utility/lodepng.h"
+#include "image/png.h"
+#include "utility/morton.h"
+#include "utility/numautil.h"
 #include "maginatics/threadpool/threadpool.h"
 #include "draw/BaseDrawer.h"
 
 namespace draw
 {
 
-SDL_Surface* BaseDrawer::renderWorld(RegionFileWorld& world, const arguments::Args& options)
+constexpr image::Color BaseDrawer::quarantineColor;
+
+image::Image BaseDrawer::renderWorld(RegionFileWorld& world, const arguments::Args& options)
+{
+    //Virtual call
+    recieveArguments(options);
+
+    MC_Point worldSize = world.getSize();
+    image::Image image(worldSize.x * scale, worldSize.z * scale, image::PixelFormat::RGBA8);
+    canvas = &image;
+    compressedCanvas = nullptr;
+
+    renderRegions(world, options);
+    canvas = nullptr;
+
+    //Add cool grid lines
+    if(gridlines) {
+        drawGirdLines(image, scale);
+    }
+
+    return image;
+}
+
+image::Image BaseDrawer::renderWorld(const std::string& filename, const arguments::Args& options)
+{
+    RegionFileWorld world(filename);
+    return renderWorld(world, options);
+}
+
+std::unique_ptr<image::CompressedCanvas> BaseDrawer::renderWorldCompressed(RegionFileWorld& world, const arguments::Args& options)
+{
+    //Virtual call
+    recieveArguments(options);
+
+    //Band memory is allocated and freed as rows finish, so it can't be placed
+    if(numaPlacement || hugePages) {
+        log("NUMA placement and huge pages are not used with a compressed canvas");
+        numaPlacement = hugePages = false;
+    }
+
+    //One band per row of regions
+    MC_Point worldSize = world.getSize();
+    auto image = std::make_unique<image::CompressedCanvas>(worldSize.x * scale, worldSize.z * scale, regionsize * scale);
+    compressedCanvas = image.get();
+    canvas = nullptr;
+
+    renderRegions(world, options);
+    compressedCanvas = nullptr;
+    image->finish();
+
+    log("Compressed canvas: ", image->getStoredSize() / (1024*1024), " of ",
+        image->getRawSize() / (1024*1024), " MB");
+
+    //Gridlines go on each band as it is saved, since bands line up with regions
+    if(gridlines) {
+        unsigned lineScale = scale;
+        image->setBandFilter([lineScale](image::Image& band, unsigned) {
+            drawGirdLines(band, lineScale);
+        });
+    }
+
+    return image;
+}
+
+std::unique_ptr<image::CompressedCanvas> BaseDrawer::renderWorldCompressed(const std::string& filename, const arguments::Args& options)
+{
+    RegionFileWorld world(filename);
+    return renderWorldCompressed(world, options);
+}
+
+bool BaseDrawer::renderTiles(RegionFileWorld& world, const arguments::Args& options)
 {
     //Virtual call
-    recieveArguments(options);        
+    recieveArguments(options);
+
+    //Tiles are written as they finish, so there's nowhere to redraw chunks later
+    if(retryQuarantined) {
+        log("Quarantined chunks are not retried when rendering tiles");
+        retryQuarantined = false;
+    }
+
+    tileDirectory = options.tileOutputDir;
+    tilesSaved = 0;
+    tilesFailed = 0;
+    canvas = nullptr;
+    compressedCanvas = nullptr;
+
+    renderRegions(world, options);
+    tileDirectory.clear();
+
+    log("Wrote ", tilesSaved.load(), " tiles to ", options.tileOutputDir);
+    if(tilesFailed) {
+        log(tilesFailed.load(), " tile(s) could not be saved");
+        return false;
+    }
+    return true;
+}
+
+bool BaseDrawer::renderTiles(const std::string& filename, const arguments::Args& options)
+{
+    RegionFileWorld world(filename);
+    return renderTiles(world, options);
+}
+
+void BaseDrawer::saveCompanionFiles(const arguments::Args& options)
+{
+    (void)options;
+}
+
+void BaseDrawer::renderRegions(RegionFileWorld& world, const arguments::Args& options)
+{
+    //Hook up to the shared chunk cache, if asked to
+    surfaceCache.reset();
+    if(!options.sharedCacheName.empty()) {
+        surfaceCache = std::make_unique<SharedSurfaceCache>(options.sharedCacheName);
+        worldKey = SharedSurfaceCache::hashWorld(world.getPath());
+    }
 
     //Find the lowest X and Z coordinates for proper offset
     MC_Point offset = getTopleftOffset(world);
 
     MC_Point worldSize = world.getSize();
-    SDL_Surface* surface = createRGBASurface(worldSize.x * scale, worldSize.z * scale);
+    int regionRows = worldSize.z / regionsize;
+
+    /* With NUMA placement, each node with CPUs gets a contiguous band of
+     * region rows, its own thread pool, and the canvas rows of that band in
+     * its memory. There's never more bands than threads or region rows.
+     * Otherwise there's just a single band, left wherever it runs (node -1) */
+    unsigned threadCount = std::max(1u, maxThreads);
+    std::vector<int> bandNodes = numaPlacement ? numautil::cpuNodes() : std::vector<int>{-1};
+    bandNodes.resize(clamp<unsigned>(bandNodes.size(), 1, std::min<unsigned>(threadCount, std::max(1, regionRows))));
+    unsigned nodes = bandNodes.size();
+    if(canvas) {
+        placeCanvas(*canvas, bandNodes, regionRows);
+    }
 
-    //Keeping track of threads in a pool
-    maginatics::ThreadPool pool(1, maxThreads, 30);
+    //Keeping track of threads in a pool (one per band), splitting the
+    //threads as evenly as possible so the total stays at "maxThreads"
+    std::vector<std::unique_ptr<maginatics::ThreadPool>> pools;
+    for(unsigned n = 0; n != nodes; ++n) {
+        unsigned threads = threadCount / nodes + (n < threadCount % nodes ? 1 : 0);
+        pools.push_back(std::make_unique<maginatics::ThreadPool>(1, threads, 30));
+    }
 
+    /* Queue regions band by band, and in Morton order rather than map order
+     * within a band, so regions being drawn at the same time are neighbours
+     * on the canvas. A compressed canvas wants whole rows finished as early
+     * as possible instead, so it gets them row by row */
+    struct QueuedRegion
+    {
+        unsigned band;
+        uint64_t key;
+        RegionFileWorld::RegionMap::value_type* region;
+    };
+    std::vector<QueuedRegion> order;
     for(auto& pair : world.getAllRegions())
     {
+        pair.second.setRequiredLevelTags(requiredLevelTags());
+
+        unsigned column = pair.first.x + offset.x;
+        unsigned row = pair.first.z + offset.z;
+        unsigned band = row * nodes / regionRows;
+        uint64_t key = compressedCanvas ? (uint64_t(row) << 32) | column : morton::encode(column, row);
+        order.push_back({band, key, &pair});
+    }
+    std::sort(order.begin(), order.end(),
+        [](const QueuedRegion& a, const QueuedRegion& b) {
+            return a.band < b.band || (a.band == b.band && a.key < b.key);
+        });
+
+    //Throttle workers on system pressure, for the length of the render
+    std::unique_ptr<background::PressureMonitor> pressureMonitor;
+    if(backgroundMode) {
+        workerGate = std::make_unique<background::WorkerGate>(maxThreads);
+        pressureMonitor = std::make_unique<background::PressureMonitor>(*workerGate, maxThreads, pressureLimit);
+        if(!pressureMonitor->isAvailable()) {
+            log("Pressure stall information (/proc/pressure) is unavailable; workers won't be throttled");
+        }
+    }
+
+    quarantined.clear();
+
+    //Snapshot of the kernel's NUMA allocation counters, to report cross-node pages
+    numautil::PageCounters pagesBefore;
+    if(numaPlacement) {
+        pagesBefore = numautil::readPageCounters();
+    }
+
+    /* Each region is one write to its row of the compressed canvas. They're
+     * all counted before any region is drawn, so a row can't be compressed
+     * while regions in it are still to be queued */
+    if(compressedCanvas) {
+        for(auto& entry : order) {
+            compressedCanvas->expectWrite((entry.region->first.z + offset.z) * regionsize * scale);
+        }
+    }
+
+    for(auto& entry : order)
+    {
+        auto& pair = *entry.region;
+
         //Location to render the region
         int x = (pair.first.x + offset.x) * regionsize;
         int z = (pair.first.z + offset.z) * regionsize;
 
+        //Node of the band, or -1 to leave the thread where it is
+        int node = bandNodes[entry.band];
+
         /* Bind the "renderRegion" member function, to call in a thread.
          * Somewhere deep inside std::bind, the copy ctor of RegionFile is called,
          * so renderRegion needs to accept a RegionFile pointer instead. (&pair.second) */
-        auto function = std::bind(&BaseDrawer::renderRegion, this, MC_Point{x,z}, surface, &pair.second);
+        auto function = std::bind(&BaseDrawer::renderRegion, this, MC_Point{x,z}, pair.first, node, &pair.second);
 
         //Queue a new thread to render this region
-        pool.execute(function);
+        pools[entry.band]->execute(function);
     }
 
-    pool.drain();
+    for(auto& pool : pools) {
+        pool->drain();
+    }
 
-    //Add cool grid lines
-    if(gridlines) {
-        drawGirdLines(surface);
+    if(numaPlacement) {
+        numautil::PageCounters pagesAfter = numautil::readPageCounters();
+        if(pagesBefore.available && pagesAfter.available) {
+            uint64_t local = pagesAfter.localNode - pagesBefore.localNode;
+            uint64_t other = pagesAfter.otherNode - pagesBefore.otherNode;
+            uint64_t missed = pagesAfter.numaMiss - pagesBefore.numaMiss;
+            log("NUMA: ", nodes, " band(s); ", other, " of ", local + other,
+                " pages allocated during the render were on another node than the CPU asking, ",
+                missed, " missed their preferred node (system-wide numastat counters)");
+        } else {
+            log("NUMA: ", nodes, " band(s); cross-node page counters (numastat) are unavailable on this host");
+        }
+    }
+
+    if(pressureMonitor && pressureMonitor->isAvailable()) {
+        log("Background: throttled ", pressureMonitor->getThrottleCount(), " time(s), down to ",
+            pressureMonitor->getMinWorkers(), " of ", maxThreads, " worker(s)");
+    }
+    pressureMonitor.reset();
+    workerGate.reset();
+
+    //Report (and maybe retry) chunks that were skipped
+    if(!quarantined.empty()) {
+        log(quarantined.size(), " chunk(s) were quarantined:");
+        for(const auto& q : quarantined) {
+            log("  region ", q.region.x, ",", q.region.z, " chunk ", q.chunk.x, ",", q.chunk.z, ": ", q.reason);
+        }
+        if(retryQuarantined) {
+            retryQuarantinedChunks();
+        }
+    }
+
+    //How much inflating was saved by stopping at the required tags
+    size_t compressedRead = 0, compressedSkipped = 0;
+    for(auto& pair : world.getAllRegions()) {
+        compressedRead += pair.second.getCompressedBytesRead();
+        compressedSkipped += pair.second.getCompressedBytesSkipped();
+    }
+    if(compressedSkipped) {
+        log("Early exit: ", compressedSkipped / 1024, " of ", compressedRead / 1024,
+            " compressed KB of chunk data not inflated");
     }
 
-    return surface;
+    if(surfaceCache) {
+        log("Shared chunk cache: ", surfaceCache->getHits(), " hits, ",
+            surfaceCache->getMisses(), " misses");
+    }
 }
 
-SDL_Surface* BaseDrawer::renderWorld(const std::string& filename, const arguments::Args& options)
+/* Render a single region to the canvas.
+ * Chunks are drawn into a region-sized tile owned by the worker thread,
+ * which is then copied onto the canvas in one go. Each region covers its
+ * own pixels of the canvas, so threads can all write to it without locking */
+void BaseDrawer::renderRegion(MC_Point location, MC_Point coord, int node, RegionFile* region)
 {
-    RegionFileWorld world(filename);
-    return renderWorld(world, options);
+    //Stick the worker to its band's node, before it allocates its tile
+    thread_local int workerNode = -1;
+    if(node != -1 && node != workerNode) {
+        numautil::runOnNode(node);
+        workerNode = node;
+    }
+
+    //Wait for a turn, if the machine is too busy for every worker to run
+    background::WorkerGate::Pass pass(workerGate.get());
+
+    //One tile per worker thread, reused for every region it draws
+    thread_local image::Image tile;
+    unsigned tileSize = regionsize * scale;
+    if(tile.width() != tileSize) {
+        tile = image::Image(tileSize, tileSize, image::PixelFormat::RGBA8);
+    } else {
+        tile.clear();
+    }
+
+    //Walk the 32x32 chunks in Morton order too, keeping tile writes close together
+    ChunkSurface surface;
+    for(uint32_t i = 0; i != 32*32; ++i)
+    {
+        int chunkX = morton::decodeX(i);
+        int chunkZ = morton::decodeZ(i);
+
+        /* A chunk that is too big, too slow, or throws while loading is
+         * quarantined: drawn as a placeholder and recorded for later,
+         * rather than holding up (or taking down) the whole render */
+        try {
+            size_t chunkSize = region->getChunkSize(chunkX, chunkZ);
+            if(maxChunkBytes && chunkSize > maxChunkBytes) {
+                error("Chunk takes ", chunkSize / 1024, " KB, over the limit of ", maxChunkBytes / 1024, " KB");
+            }
+
+            Deadline deadline;
+            if(chunkTimeout.count() > 0) {
+                deadline = Deadline(chunkTimeout);
+            }
+
+            if(loadChunkSurface(coord, region, chunkX, chunkZ, surface, deadline)) {
+                //The draw location is relative to the tile's top-left
+                renderChunk(MC_Point{chunkX*16, chunkZ*16}, &tile, surface);
+            }
+        }
+        catch(std::exception& ex) {
+            quarantine(QuarantinedChunk{ coord, MC_Point{chunkX, chunkZ}, location, region, ex.what() });
+            tile.fillRect(chunkX*16*scale, chunkZ*16*scale, 16*scale, 16*scale, quarantineFill());
+        }
+    }
+
+    //Each region is a tile of its own, with no canvas
+    if(!tileDirectory.empty()) {
+        std::string tileFilename = tileDirectory + "/r." + std::to_string(coord.x) + "." + std::to_string(coord.z) + ".png";
+        try {
+            image::savePNG(tile, tileFilename);
+            tilesSaved++;
+        }
+        catch(std::exception& ex) {
+            log("Could not save tile ", tileFilename, ": ", ex.what());
+            tilesFailed++;
+        }
+        return;
+    }
+
+    placeTile(tile, location.x * scale, location.z * scale);
+    if(compressedCanvas) {
+        compressedCanvas->finishWrite(location.z * scale);
+    }
+}
+
+void BaseDrawer::quarantine(const QuarantinedChunk& chunk)
+{
+    std::lock_guard<std::mutex> lock(quarantineMutex);
+    quarantined.push_back(chunk);
+}
+
+void BaseDrawer::placeTile(const image::Image& tile, int x, int y)
+{
+    if(compressedCanvas) {
+        compressedCanvas->blit(tile, x, y);
+    } else {
+        canvas->blit(tile, x, y);
+    }
 }
 
-/* Render a single region to an existing surface.
- * The renderer is created in this function to ensure one renderer per thread.
- * They're all just spitting things out to the same surface */
-void BaseDrawer::renderRegion(MC_Point location,  SDL_Surface* surface, RegionFile* region)
+void BaseDrawer::retryQuarantinedChunks()
 {
-    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(surface);
-    SDL_RenderSetScale(renderer, scale, scale);
+    log("Retrying ", quarantined.size(), " quarantined chunk(s) on a single thread, without limits");
 
-    for(const auto& pair : region->getAllChunks())
+    //Chunks are redrawn through a chunk-sized tile, as with whole regions
+    image::Image tile(16 * scale, 16 * scale, image::PixelFormat::RGBA8);
+    ChunkSurface surface;
+    for(const auto& q : quarantined)
     {
-        //The draw location is: region location + chunk location
-        int x = location.x + pair.first.x*16;
-        int z = location.z + pair.first.z*16;
+        try {
+            if(loadChunkSurface(q.region, q.file, q.chunk.x, q.chunk.z, surface, Deadline())) {
+                int x = q.location.x + q.chunk.x*16;
+                int z = q.location.z + q.chunk.z*16;
+                renderChunk(MC_Point{0,0}, &tile, surface);
+                placeTile(tile, x * scale, z * scale);
+            }
+        }
+        catch(std::exception& ex) {
+            log("  region ", q.region.x, ",", q.region.z, " chunk ", q.chunk.x, ",", q.chunk.z,
+                " failed again: ", ex.what());
+        }
+    }
+}
+
+const std::vector<BaseDrawer::QuarantinedChunk>& BaseDrawer::getQuarantinedChunks() const
+{
+    return quarantined;
+}
+
+void BaseDrawer::placeCanvas(image::Image& canvas, const std::vector<int>& bandNodes, int regionRows)
+{
+    if(canvas.empty()) {
+        return;
+    }
 
-        renderChunk(MC_Point{x,z}, renderer, pair.second);
+    size_t rowBytes = canvas.pitch();
+    if(hugePages) {
+        numautil::adviseHugePages(canvas.row(0), rowBytes * canvas.height());
+    }
+    if(!numaPlacement) {
+        return;
     }
 
-    SDL_DestroyRenderer(renderer);
+    /* Band "b" holds the region rows r where r * nodes / regionRows == b,
+     * that is from ceil(b * regionRows / nodes) up to the next band's start */
+    unsigned nodes = bandNodes.size();
+    for(unsigned band = 0; band != nodes; ++band)
+    {
+        int firstRow = (band * regionRows + nodes - 1) / nodes;
+        int lastRow = ((band+1) * regionRows + nodes - 1) / nodes;
+
+        unsigned y0 = firstRow * regionsize * scale;
+        unsigned y1 = std::min<unsigned>(lastRow * regionsize * scale, canvas.height());
+        if(y1 > y0) {
+            numautil::bindToNode(canvas.row(y0), rowBytes * (y1 - y0), bandNodes[band]);
+        }
+    }
 }
 
-void BaseDrawer::renderChunk(MC_Point location,
-                         SDL_Renderer* renderer,
-                         nbt_node *chunk)
+bool BaseDrawer::loadChunkSurface(MC_Point coord, RegionFile* region, int x, int z,
+                                  ChunkSurface& surface, const Deadline& deadline)
 {
+    if(!region->hasChunk(x, z)) {
+        return false;
+    }
+
+    SharedSurfaceCache::Key key = { worldKey, coord.x, coord.z, x, z, region->getTimestamp(x, z) };
+    if(surfaceCache && surfaceCache->lookup(key, surface)) {
+        return true;
+    }
+
+    //The chunk is there, so no NBT means its data is unreadable or corrupt
+    nbt_node* chunk = region->getChunkNBT(x, z, deadline);
+    if(!chunk) {
+        error("Chunk data could not be read or decoded");
+    }
+
     //Wrapper to tell us info about the ID at a position
     ChunkInterface iface(chunk);
+    surface.extract(iface, deadline);
 
+    if(surfaceCache) {
+        surfaceCache->publish(key, surface);
+    }
+    return true;
+}
+
+void BaseDrawer::renderChunk(MC_Point location,
+                         image::Image* canvas,
+                         const ChunkSurface& surface)
+{
     //This is where it all comes together!
     for(int z = 0; z != 16; ++z)
     for(int x = 0; x != 16; ++x)
     {
     	//Virtual call
-        SDL_Color color = renderBlock(iface, x, z);
+        image::Color color = renderBlock(surface, x, z);
 
-        //Draw above color on image
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderDrawPoint(renderer, location.x + x, location.z + z);
+        //Draw above color on image, as a "scale" sized square
+        int px = (location.x + x) * scale;
+        int pz = (location.z + z) * scale;
+        canvas->fillRect(px, pz, scale, scale, color);
     }
 }
 
@@ -116,38 +502,30 @@ MC_Point BaseDrawer::getTopleftOffset(RegionFileWorld& world)
     return { abs(lowestX), abs(lowestZ) };
 }
 
-void BaseDrawer::drawGirdLines(SDL_Surface* s)
+void BaseDrawer::drawGirdLines(image::Image& canvas, unsigned scale)
 {
-    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(s);
-    SDL_RenderSetScale(renderer, scale, scale);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    //Lines are one block wide, so "scale" pixels thick
+    const image::Color black{0, 0, 0, 255};
+    int w = canvas.width(), h = canvas.height();
+    int step = regionsize * scale;
 
     //Vertical lines
-    for(int x = 0; x < s->w; x += regionsize)
-        SDL_RenderDrawLine(renderer, x, 0, x, s->h);
+    for(int x = 0; x < w; x += step)
+        canvas.fillRect(x, 0, scale, h, black);
 
     //Horizontal lines
-    for(int y = 0; y < s->h; y += regionsize)
-        SDL_RenderDrawLine(renderer, 0, y, s->w, y);
-        
-    SDL_DestroyRenderer(renderer);
+    for(int y = 0; y < h; y += step)
+        canvas.fillRect(0, y, w, scale, black);
 }
 
-SDL_Surface* BaseDrawer::createRGBASurface(int w, int h)
+std::vector<std::string> BaseDrawer::requiredLevelTags() const
 {
-    SDL_Surface* surface =  SDL_CreateRGBSurface(0, w, h, 32,
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF
-#else
-    0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000
-#endif
-    );
-
-    if(!surface) {
-        error("Cannot create rendering surface: ", SDL_GetError());
-    }
+    return { "HeightMap", "Sections" };
+}
 
-    return surface;
+image::Color BaseDrawer::quarantineFill() const
+{
+    return quarantineColor;
 }
 
 void BaseDrawer::recieveArguments(const arguments::Args& options)
@@ -160,6 +538,19 @@ void BaseDrawer::recieveArguments(const arguments::Args& options)
 
     //Draw gridlines
     gridlines = options.gridlines;
+
+    //Chunk limits and quarantine
+    chunkTimeout = std::chrono::milliseconds(options.chunkTimeoutMs);
+    maxChunkBytes = size_t(options.maxChunkKB) * 1024;
+    retryQuarantined = options.retryQuarantined;
+
+    //NUMA and memory placement
+    numaPlacement = options.numa;
+    hugePages = options.hugePages;
+
+    //Background throttling
+    backgroundMode = options.background;
+    pressureLimit = options.pressureLimit;
 }
 
 }
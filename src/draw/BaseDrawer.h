@@ -1,12 +1,22 @@
 #ifndef BASEDRAWER_H
 #define BASEDRAWER_H
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include "types.h"
+#include "image/Image.h"
+#include "image/CompressedCanvas.h"
 #include "anvil/ChunkInterface.h"
+#include "anvil/ChunkSurface.h"
+#include "anvil/SharedSurfaceCache.h"
 #include "blocks/blocks.h"
 #include "anvil/RegionFile.h"
 #include "anvil/RegionFileWorld.h"
 #include "utility/arguments.h"
+#include "utility/deadline.h"
+#include "utility/background.h"
 #include "nbt/nbt.h"
 
 /* Abstract base renderer class. BaseDrawer handles threads, image stitching,
@@ -21,15 +31,56 @@ namespace draw
 class BaseDrawer : arguments::ArgumentReciever
 {
 public:
-    /* Renders a world (loaded or from file); returns an RGBA SDL_Surface of the image.
+    /* Renders a world (loaded or from file); returns an RGBA8 image::Image of the render.
      * "options" are entered from the command line, to be used for drawing options.
-     * Can be saved by draw::saveSurfacePNG (or your method) */
-    SDL_Surface* renderWorld(RegionFileWorld& world, const arguments::Args& options);
-    SDL_Surface* renderWorld(const std::string& filename, const arguments::Args& options);
+     * Can be saved by draw::saveImagePNG (or your method) */
+    image::Image renderWorld(RegionFileWorld& world, const arguments::Args& options);
+    image::Image renderWorld(const std::string& filename, const arguments::Args& options);
+
+    /* Same as above, but onto a canvas that keeps finished rows of regions
+     * compressed, for worlds whose render wouldn't fit in memory.
+     * Save it with its savePNG */
+    std::unique_ptr<image::CompressedCanvas> renderWorldCompressed(RegionFileWorld& world, const arguments::Args& options);
+    std::unique_ptr<image::CompressedCanvas> renderWorldCompressed(const std::string& filename, const arguments::Args& options);
+
+    /* Renders a world as one PNG per region instead of one image, named
+     * "r.<x>.<z>.png" after the region, in options.tileOutputDir.
+     * Tiles are 512 * scale pixels square, and saved as each region is drawn.
+     * Returns false if any tile could not be saved */
+    bool renderTiles(RegionFileWorld& world, const arguments::Args& options);
+    bool renderTiles(const std::string& filename, const arguments::Args& options);
+
+    /* Write whatever goes along with a render once it has been saved, such as
+     * the palette of data tiles. Nothing by default. Throws on failure */
+    virtual void saveCompanionFiles(const arguments::Args& options);
+
+    //A chunk that was skipped during the last render, and why
+    struct QuarantinedChunk
+    {
+        MC_Point region;    //Region coordinate
+        MC_Point chunk;     //Chunk in the region, 0-31
+        MC_Point location;  //Where the region is drawn, in blocks
+        RegionFile* file;
+        std::string reason;
+    };
+
+    //Chunks skipped in the last render. Drawn with quarantineFill()
+    const std::vector<QuarantinedChunk>& getQuarantinedChunks() const;
+
+    //Placeholder drawn in place of a quarantined chunk, by default
+    static constexpr image::Color quarantineColor{255, 0, 255, 255};
 
 protected:
     void recieveArguments(const arguments::Args& args) override;
-    virtual SDL_Color renderBlock(ChunkInterface& iface, int x, int z) = 0;
+    virtual image::Color renderBlock(const ChunkSurface& surface, int x, int z) = 0;
+
+    //Color filling quarantined chunks; quarantineColor unless overridden
+    virtual image::Color quarantineFill() const;
+
+    /* Tags under a chunk's "Level" this drawer needs. Chunks are only inflated
+     * until these have been read. The default is what ChunkSurface reads;
+     * return an empty list to always load whole chunks */
+    virtual std::vector<std::string> requiredLevelTags() const;
 
 private:
     //Width of a region in blocks
@@ -43,17 +94,71 @@ private:
     //Draw gridline options
     bool gridlines = false;
 
-    //Render a single chunk to an existing surface
-    void renderChunk(MC_Point location, SDL_Renderer *renderer, nbt_node* chunk);
+    //Optional cache of chunk surfaces shared with other render processes,
+    //and the key of the world being rendered in it
+    std::unique_ptr<SharedSurfaceCache> surfaceCache;
+    uint64_t worldKey = 0;
+
+    /* NUMA placement: regions are split into one band of rows per node, with
+     * the band's workers and canvas memory on that node */
+    bool numaPlacement = false;
+    bool hugePages = false;
+
+    /* Per-chunk limits. A chunk that takes more than "chunkTimeout" to load
+     * (checked between inflate steps and surface rows) or more than
+     * "maxChunkBytes" in the file is quarantined. 0 means no limit */
+    std::chrono::milliseconds chunkTimeout{0};
+    size_t maxChunkBytes = 0;
+    bool retryQuarantined = false;
+
+    /* Background mode: a PSI monitor shrinks how many workers may draw at
+     * once while the machine is under pressure (see background.h) */
+    bool backgroundMode = false;
+    double pressureLimit = 0;
+    std::unique_ptr<background::WorkerGate> workerGate;
+
+    //Where the current render is drawn; one of these is set while rendering
+    image::Image* canvas = nullptr;
+    image::CompressedCanvas* compressedCanvas = nullptr;
+    //...or, if not empty, the folder region tiles are saved in,
+    //with how many of them were saved and how many could not be
+    std::string tileDirectory;
+    std::atomic<unsigned> tilesSaved{0};
+    std::atomic<unsigned> tilesFailed{0};
+
+    std::mutex quarantineMutex;
+    std::vector<QuarantinedChunk> quarantined;
+
+    //Add a chunk to the quarantine list (thread safe)
+    void quarantine(const QuarantinedChunk& chunk);
+
+    //Load and draw quarantined chunks again, one at a time with no limits
+    void retryQuarantinedChunks();
+
+    //Render every region of a world onto whichever canvas is set
+    void renderRegions(RegionFileWorld& world, const arguments::Args& options);
+
+    //Copy a finished tile onto the canvas, at x,y in pixels
+    void placeTile(const image::Image& tile, int x, int y);
+
+    //Put each band of canvas rows on its node ("bandNodes"), and set up huge pages
+    void placeCanvas(image::Image& canvas, const std::vector<int>& bandNodes, int regionRows);
+
+    //Render a single chunk's surface to an existing image at "location" XZ (in blocks)
+    void renderChunk(MC_Point location, image::Image* canvas, const ChunkSurface& surface);
 
-    //Render a single region to an existing surface at "location" XY
-    void renderRegion(MC_Point location, SDL_Surface* surface, RegionFile* region);
+    /* Render a single region (at region coordinate "coord") to an existing image
+     * at "location" XZ (in blocks), by way of a per-thread region-sized tile.
+     * If "node" isn't -1, the calling thread is first moved onto that NUMA node */
+    void renderRegion(MC_Point location, MC_Point coord, int node, RegionFile* region);
 
-    /* Ccreate a 32-bit RGBA surface taking endianness into account */
-    SDL_Surface* createRGBASurface(int w, int h);
+    /* Get the surface of chunk x,z in a region, from the shared cache if possible.
+     * Returns false if there is no such chunk, and throws if its data is bad */
+    bool loadChunkSurface(MC_Point coord, RegionFile* region, int x, int z,
+                          ChunkSurface& surface, const Deadline& deadline);
 
-    //Put region-sized (512x512) gridlines on a surface
-    void drawGirdLines(SDL_Surface* s);
+    //Put region-sized (512x512) gridlines on an image, drawn at "scale"
+    static void drawGirdLines(image::Image& canvas, unsigned scale);
 
     /* This gives us the magnitude of left-most (-X) and top-most (-Z) regions,
      * e.g.: A world has r.-3.-2.mca and r.0.-4.mca -> {3,4}
@@ -0,0 +1,19 @@
+#include "draw/CustomDrawer.h"
+
+namespace draw
+{
+
+image::Color CustomDrawer::renderBlock(const ChunkSurface& surface, int x, int z)
+{
+    return rules.getColor(surface.getPackedID(x, z), surface.getHeight(x, z));
+}
+
+void CustomDrawer::recieveArguments(const arguments::Args& options)
+{
+    NormalDrawer::recieveArguments(options);
+
+    //Compile the rules on top of the colors NormalDrawer loaded
+    rules.load(options.rulesFilename, colors);
+}
+
+}
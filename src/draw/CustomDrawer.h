@@ -0,0 +1,25 @@
+#ifndef CUSTOMDRAWER_H
+#define CUSTOMDRAWER_H
+#include "draw/NormalDrawer.h"
+#include "blocks/ColorRules.h"
+
+/* CustomDrawer colors blocks with a rule file (see blocks::ColorRules)
+ * applied on top of the normal block colors */
+
+namespace draw
+{
+
+class CustomDrawer : public NormalDrawer
+{
+protected:
+    image::Color renderBlock(const ChunkSurface& surface, int x, int z) override;
+    void recieveArguments(const arguments::Args& options) override;
+
+private:
+    //Rules compiled into color tables
+    blocks::ColorRules rules;
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "utility/utility.h"
+#include "draw/DataDrawer.h"
+
+namespace draw
+{
+
+image::Color DataDrawer::renderBlock(const ChunkSurface& surface, int x, int z)
+{
+    uint16_t packed = surface.getPackedID(x, z);
+    if(packed == ChunkSurface::invalidPacked) {
+        return image::Color{0, 0, 0, image::ALPHA_TRANSPARENT};
+    }
+
+    return image::Color{ uint8_t(packed >> 8), uint8_t(packed & 0xFF),
+                         surface.getHeight(x, z), image::ALPHA_OPAQUE };
+}
+
+image::Color DataDrawer::quarantineFill() const
+{
+    return image::Color{0, 0, 0, quarantinedAlpha};
+}
+
+void DataDrawer::saveCompanionFiles(const arguments::Args& options)
+{
+    //The palette goes with the tiles, or next to the single image
+    std::string paletteFilename;
+    if(!options.tileOutputDir.empty()) {
+        paletteFilename = options.tileOutputDir + "/palette.json";
+    } else {
+        paletteFilename = options.outputFilename;
+        size_t dot = paletteFilename.rfind(".png");
+        if(dot != std::string::npos && dot + 4 == paletteFilename.size()) {
+            paletteFilename.resize(dot);
+        }
+        paletteFilename += ".palette.json";
+    }
+
+    colors.savePalette(paletteFilename, quarantinedAlpha);
+    log("Wrote block palette to ", paletteFilename);
+}
+
+}
@@ -0,0 +1,32 @@
+#ifndef DATADRAWER_H
+#define DATADRAWER_H
+#include "draw/NormalDrawer.h"
+
+/* DataDrawer outputs data rather than colors, for clients that style maps
+ * themselves. Each pixel holds the top block packed as (id << 4) | meta
+ * (see ChunkSurface) in red (high byte) and green (low byte), and its Y in
+ * blue. Alpha is opaque where there is a block and clear where there's none.
+ * Quarantined chunks are filled with zeros and an alpha of quarantinedAlpha,
+ * so they can't be mistaken for blocks or for empty space.
+ * Once the render is saved, a palette of the normal block colors is written
+ * beside it (see BlockColors::savePalette), so one render can be drawn in any style */
+
+namespace draw
+{
+
+class DataDrawer : public NormalDrawer
+{
+public:
+    //Alpha marking pixels of quarantined chunks; recorded in the palette
+    static const uint8_t quarantinedAlpha = 1;
+
+    void saveCompanionFiles(const arguments::Args& options) override;
+
+protected:
+    image::Color renderBlock(const ChunkSurface& surface, int x, int z) override;
+    image::Color quarantineFill() const override;
+};
+
+}
+
+#endif
@@ -4,14 +4,14 @@
 namespace draw
 {
 
-SDL_Color HeightmapDrawer::renderBlock(ChunkInterface& iface, int x, int z)
+image::Color HeightmapDrawer::renderBlock(const ChunkSurface& surface, int x, int z)
 {
     //Right-most hue on the HSV scale to consider any block
     const int MAX_HUE = 180;
     //Minecraft height we consider maximum
     const int MAX_MC_HEIGHT = 128;
 
-    Uint8 hightestY = iface.getHighestSolidBlockY(x, z);
+    uint8_t hightestY = surface.getHeight(x, z);
 
     // 0..MAX_MC_HEIGHT scaled to 0..MAX_HUE (HSV hue range)
     // "MAX_HUE - hue" is used to go from the center of the HSV scale to the left
@@ -20,7 +20,7 @@ SDL_Color HeightmapDrawer::renderBlock(ChunkInterface& iface, int x, int z)
     hue = clamp(hue, 0, MAX_HUE);
 
     //Cache hue colors for retrieval
-    if(colorCache[hue].a == SDL_ALPHA_TRANSPARENT) {
+    if(colorCache[hue].a == image::ALPHA_TRANSPARENT) {
         colorCache[hue] = hsv2rgb(hue, 1.0, 1.0);
     }
 
@@ -28,11 +28,11 @@ SDL_Color HeightmapDrawer::renderBlock(ChunkInterface& iface, int x, int z)
 }
 
 //This forumla can be found on Wikipedia or similar, searching for "hsv to rgb"
-SDL_Color HeightmapDrawer::hsv2rgb(float h, float s, float v)
+image::Color HeightmapDrawer::hsv2rgb(float h, float s, float v)
 {
     double      hh, p, q, t, ff;
     long        i;
-    SDL_Color   out;
+    image::Color out;
 
     if(s <= 0.0) {
         out.r = v;
@@ -50,7 +50,7 @@ SDL_Color HeightmapDrawer::hsv2rgb(float h, float s, float v)
     q = v * (1.0 - (s * ff));
     t = v * (1.0 - (s * (1.0 - ff)));
 
-    //float 0..1 range to byte 0..255 range, for SDL_Color
+    //float 0..1 range to byte 0..255 range, for image::Color
     v *= 255; t *= 255; p *= 255; q *= 255;
 
     switch(i)
@@ -64,7 +64,7 @@ SDL_Color HeightmapDrawer::hsv2rgb(float h, float s, float v)
     }
 
     //Fully opaque output
-    out.a = SDL_ALPHA_OPAQUE;
+    out.a = image::ALPHA_OPAQUE;
 
     return out;
 }
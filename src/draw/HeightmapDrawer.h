@@ -11,11 +11,11 @@ namespace draw
 class HeightmapDrawer : public BaseDrawer
 {
 protected:
-    SDL_Color renderBlock(ChunkInterface& iface, int x, int z) override;
+    image::Color renderBlock(const ChunkSurface& surface, int x, int z) override;
 
 private:
-    std::array<SDL_Color, 360> colorCache;
-    SDL_Color hsv2rgb(float h, float s, float v);
+    std::array<image::Color, 360> colorCache;
+    image::Color hsv2rgb(float h, float s, float v);
 };
 
 }
@@ -4,10 +4,9 @@
 namespace draw
 {
 
-SDL_Color NormalDrawer::renderBlock(ChunkInterface& iface, int x, int z)
+image::Color NormalDrawer::renderBlock(const ChunkSurface& surface, int x, int z)
 {
-    blocks::BlockID id = iface.getHighestSolidBlockID(x, z);
-    return colors.getBlockColor(id);
+    return colors.getPackedColor(surface.getPackedID(x, z));
 }
 
 void NormalDrawer::recieveArguments(const arguments::Args& options) 
@@ -10,10 +10,9 @@ namespace draw
 class NormalDrawer : public BaseDrawer
 {
 protected:
-    SDL_Color renderBlock(ChunkInterface& iface, int x, int z) override;
+    image::Color renderBlock(const ChunkSurface& surface, int x, int z) override;
     void recieveArguments(const arguments::Args& options) override;
 
-private:
     //Item to get colors based on block IDs
     blocks::BlockColors colors;
 };
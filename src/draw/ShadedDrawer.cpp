@@ -4,13 +4,13 @@
 namespace draw
 {
 
-SDL_Color ShadedDrawer::renderBlock(ChunkInterface& iface, int x, int z)
+image::Color ShadedDrawer::renderBlock(const ChunkSurface& surface, int x, int z)
 {
     //Height of about sea level. "middle" height of a map
     const int MC_ABOVE_SEA_LEVEL = 80;
 
-    SDL_Color color = NormalDrawer::renderBlock(iface, x, z);
-    int blockY = iface.getHighestSolidBlockY(x, z);
+    image::Color color = NormalDrawer::renderBlock(surface, x, z);
+    int blockY = surface.getHeight(x, z);
 
     //A value, 0 to 1.1, which multiplies each RGB component
     //to obtain a ligher or darker color
@@ -11,7 +11,7 @@ namespace draw
 class ShadedDrawer : public NormalDrawer
 {
 protected:
-    SDL_Color renderBlock(ChunkInterface& iface, int x, int z) override;
+    image::Color renderBlock(const ChunkSurface& surface, int x, int z) override;
 };
 
 }
@@ -1,7 +1,7 @@
-#include <SDL2/SDL.h>
+#include <functional>
+#include <memory>
 #include "utility/utility.h"
-#include "utility/savepng.h"
-#include "utility/lodepng.h"
+#include "image/png.h"
 #include "draw/draw.h"
 
 namespace draw
@@ -35,7 +35,9 @@ static const std::map<DrawerType, DrawerRegistry> drawerRegistry =
 {
     { DrawerType::Normal,    makeDrawerRegistry<NormalDrawer>("normal")    },
     { DrawerType::HeightMap, makeDrawerRegistry<HeightmapDrawer>("height") },
-    { DrawerType::Shaded,    makeDrawerRegistry<ShadedDrawer>("shaded")    }       
+    { DrawerType::Shaded,    makeDrawerRegistry<ShadedDrawer>("shaded")    },
+    { DrawerType::Custom,    makeDrawerRegistry<CustomDrawer>("custom")    },
+    { DrawerType::Data,      makeDrawerRegistry<DataDrawer>("data")        }
 };
 
 /* ------------------------------------------------------------------------- */
@@ -84,19 +86,29 @@ std::string getDrawerName(const DrawerType& type)
     error("Invalid drawer type \"", int(type));    
 }
 
-/* On Windows, use a lodepng (no extra dependencies). *nix, use libpng */
-bool saveSurfacePNG(SDL_Surface* surface, const std::string& filename)
+/* The PNG encoder throws on failure; turn that into a return value here */
+bool saveImagePNG(const image::Image& img, const std::string& filename)
 {
-#ifdef __WINDOWS__
-    int w = surface->w;
-    int h = surface->h;
-    return lodepng::encode(filename, (unsigned char*)surface->pixels, w, h) == 0;
-#else
-    int success =  SDL_SavePNG(surface, filename.c_str());
-    if(success != 0) {
-        error("Could not save PNG: ", SDL_GetError());
+    try {
+        image::savePNG(img, filename);
     }
-#endif
+    catch(std::exception& ex) {
+        log("Could not save PNG: ", ex.what());
+        return false;
+    }
+    return true;
+}
+
+bool saveImagePNG(const image::CompressedCanvas& img, const std::string& filename)
+{
+    try {
+        img.savePNG(filename);
+    }
+    catch(std::exception& ex) {
+        log("Could not save PNG: ", ex.what());
+        return false;
+    }
+    return true;
 }
 
 }
@@ -4,6 +4,8 @@
 #include "draw/NormalDrawer.h"
 #include "draw/HeightmapDrawer.h"
 #include "draw/ShadedDrawer.h"
+#include "draw/CustomDrawer.h"
+#include "draw/DataDrawer.h"
 
 /* Top-level draw include file. */
 
@@ -15,7 +17,9 @@ enum class DrawerType
 {
     Normal = 0,
     HeightMap,
-    Shaded
+    Shaded,
+    Custom,
+    Data
 };
 
 /* Returns a new instance of a drawer based on type */
@@ -29,9 +33,10 @@ DrawerType getDrawerType(const std::string& drawerName);
 /* Return drawer name based on type; opposite of above */
 std::string getDrawerName(const DrawerType& type);
 
-/* Generic helper function to save a surface to a PNG at "filename"
+/* Generic helper function to save an image to a PNG at "filename"
  * return true on success */
-bool saveSurfacePNG(SDL_Surface* surface, const std::string& filename);
+bool saveImagePNG(const image::Image& img, const std::string& filename);
+bool saveImagePNG(const image::CompressedCanvas& img, const std::string& filename);
 
 }
 
@@ -0,0 +1,30 @@
+#ifndef COLOR_H
+#define COLOR_H
+#include <stdint.h>
+
+/* A plain RGBA color, used everywhere a pixel value is passed around
+ * (drawers, block colors, images) */
+
+namespace image
+{
+
+//Alpha values for a fully see-through or fully solid pixel
+static const uint8_t ALPHA_TRANSPARENT = 0;
+static const uint8_t ALPHA_OPAQUE = 255;
+
+struct Color
+{
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = ALPHA_TRANSPARENT;
+};
+
+/* Pack/unpack a color as a single 0xRRGGBBAA integer. This is the
+ * layout the block color .json cache has always been stored in */
+uint32_t packRGBA(const Color& color);
+Color unpackRGBA(uint32_t pixel);
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <zlib.h>
+#include "utility/utility.h"
+#include "image/png.h"
+#include "image/CompressedCanvas.h"
+
+namespace image
+{
+
+CompressedCanvas::CompressedCanvas(unsigned width, unsigned height, unsigned bandRows)
+    : w(width), h(height), bandRows(std::max(1u, bandRows))
+{
+    bands.resize((h + this->bandRows - 1) / this->bandRows);
+}
+
+unsigned CompressedCanvas::width() const
+{
+    return w;
+}
+
+unsigned CompressedCanvas::height() const
+{
+    return h;
+}
+
+void CompressedCanvas::expectWrite(unsigned y)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bands[y / bandRows].pending++;
+}
+
+void CompressedCanvas::blit(const Image& src, int x, int y)
+{
+    //Split the source along band boundaries
+    int top = std::max(y, 0);
+    int bottom = std::min<int>(y + src.height(), h);
+
+    for(int row = top; row < bottom; )
+    {
+        unsigned band = row / bandRows;
+        int bandTop = band * bandRows;
+        int bandBottom = std::min<int>(bandTop + bandHeight(band), bottom);
+
+        //Rows of src that land in this band
+        Image part;
+        const Image* piece = &src;
+        if(row != y || bandBottom - row != int(src.height())) {
+            part = Image(src.width(), bandBottom - row, src.format());
+            for(int r = row; r != bandBottom; ++r) {
+                memcpy(part.row(r - row), src.row(r - y), part.pitch());
+            }
+            piece = &part;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if(bands[band].pending > 0) {
+            //The band stays open until its writes finish; draw without the lock
+            Image& pixels = open(band);
+            lock.unlock();
+            pixels.blit(*piece, x, row - bandTop);
+        } else {
+            //A write nobody expected; open the band just for it
+            open(band).blit(*piece, x, row - bandTop);
+            close(band);
+        }
+
+        row = bandBottom;
+    }
+}
+
+void CompressedCanvas::finishWrite(unsigned y)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned band = y / bandRows;
+    if(bands[band].pending > 0 && --bands[band].pending == 0) {
+        close(band);
+    }
+}
+
+void CompressedCanvas::finish()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for(unsigned band = 0; band != bands.size(); ++band) {
+        bands[band].pending = 0;
+        close(band);
+    }
+}
+
+void CompressedCanvas::setBandFilter(const BandFilter& filter)
+{
+    this->filter = filter;
+}
+
+void CompressedCanvas::savePNG(const std::string& filename) const
+{
+    //One band is uncompressed at a time, as the encoder asks for its rows
+    Image current;
+    unsigned currentBand = UINT_MAX;
+
+    auto rows = [&](unsigned y) -> const uint8_t* {
+        unsigned band = y / bandRows;
+        if(band != currentBand) {
+            unpack(band, current);
+            if(filter) {
+                filter(current, band * bandRows);
+            }
+            currentBand = band;
+        }
+        return current.row(y - band * bandRows);
+    };
+
+    image::savePNG(w, h, PixelFormat::RGBA8, {}, rows, filename);
+}
+
+size_t CompressedCanvas::getRawSize() const
+{
+    size_t rowBytes = size_t(w) * 4;
+    return rowBytes * h;
+}
+
+size_t CompressedCanvas::getStoredSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for(const Band& band : bands) {
+        total += band.packed.size();
+        if(band.pixels) {
+            total += band.pixels->pitch() * band.pixels->height();
+        }
+    }
+    return total;
+}
+
+unsigned CompressedCanvas::bandHeight(unsigned band) const
+{
+    return std::min(bandRows, h - band * bandRows);
+}
+
+Image& CompressedCanvas::open(unsigned band)
+{
+    Band& b = bands[band];
+    if(!b.pixels) {
+        auto pixels = std::make_unique<Image>(w, bandHeight(band), PixelFormat::RGBA8);
+        unpack(band, *pixels);
+        b.pixels = std::move(pixels);
+        b.packed.clear();
+        b.packed.shrink_to_fit();
+    }
+    return *b.pixels;
+}
+
+void CompressedCanvas::close(unsigned band)
+{
+    Band& b = bands[band];
+    if(!b.pixels) {
+        return;
+    }
+
+    /* Deflate the whole band, padding and all, at the fastest level; map
+     * images are mostly runs of the same few colors, so this goes a long way */
+    size_t rawSize = b.pixels->pitch() * b.pixels->height();
+    uLongf packedSize = compressBound(rawSize);
+    b.packed.resize(packedSize);
+    if(compress2(b.packed.data(), &packedSize, b.pixels->row(0), rawSize, 1) != Z_OK) {
+        error("Could not compress canvas band ", band);
+    }
+    b.packed.resize(packedSize);
+    b.packed.shrink_to_fit();
+    b.pixels.reset();
+}
+
+void CompressedCanvas::unpack(unsigned band, Image& out) const
+{
+    const Band& b = bands[band];
+    unsigned rows = bandHeight(band);
+    if(out.width() != w || out.height() != rows) {
+        out = Image(w, rows, PixelFormat::RGBA8);
+    }
+
+    if(b.pixels) {
+        out.blit(*b.pixels, 0, 0);
+        return;
+    }
+    if(b.packed.empty()) {
+        out.clear();
+        return;
+    }
+
+    uLongf rawSize = out.pitch() * out.height();
+    if(uncompress(out.row(0), &rawSize, b.packed.data(), b.packed.size()) != Z_OK) {
+        error("Could not uncompress canvas band ", band);
+    }
+}
+
+}
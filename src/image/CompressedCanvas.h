@@ -0,0 +1,92 @@
+#ifndef COMPRESSEDCANVAS_H
+#define COMPRESSEDCANVAS_H
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include "image/Image.h"
+
+/* CompressedCanvas is an RGBA8 canvas for outputs too big to hold in memory
+ * as one Image. It is split into horizontal bands (one row of regions each).
+ * A band is only uncompressed while it is being drawn: once every write
+ * expected in it has finished, it is deflated in memory and the pixels are
+ * freed. Bands nothing was drawn into take no memory at all.
+ *
+ * Saving streams the PNG out a band at a time, so only one band is ever
+ * uncompressed while encoding. The PNG is the same as for a plain Image. */
+
+namespace image
+{
+
+class CompressedCanvas
+{
+public:
+    //Called on each band, uncompressed, just before it is encoded
+    typedef std::function<void(Image& band, unsigned firstRow)> BandFilter;
+
+public:
+    CompressedCanvas(unsigned width, unsigned height, unsigned bandRows);
+    CompressedCanvas(const CompressedCanvas&) = delete;
+
+    unsigned width() const;
+    unsigned height() const;
+
+    /* Say that one more write (blit + finishWrite) will cover row "y".
+     * A band is compressed when the last write expected in it finishes */
+    void expectWrite(unsigned y);
+
+    /* Copy "src" onto the canvas with its top-left at x,y. Different threads
+     * may write to the same band at once, as long as the pixels differ.
+     * Writing to a band that was already compressed works, but is slow */
+    void blit(const Image& src, int x, int y);
+
+    //A write expected with expectWrite(y) is done
+    void finishWrite(unsigned y);
+
+    //Compress every band still open, e.g. ones with missing writes
+    void finish();
+
+    //Set a filter run on each band before encoding (e.g. gridlines)
+    void setBandFilter(const BandFilter& filter);
+
+    //Write the canvas as a PNG. Throws on failure
+    void savePNG(const std::string& filename) const;
+
+    //Bytes the canvas would take uncompressed, and takes right now
+    size_t getRawSize() const;
+    size_t getStoredSize() const;
+
+private:
+    struct Band
+    {
+        //Pixels while the band is being drawn, else null
+        std::unique_ptr<Image> pixels;
+        //Deflated pixels once done; empty if nothing was ever drawn
+        std::vector<uint8_t> packed;
+        //Writes still expected
+        unsigned pending = 0;
+    };
+
+    unsigned w, h, bandRows;
+    std::vector<Band> bands;
+    BandFilter filter;
+
+    //Guards opening and closing bands (not the pixel writes themselves)
+    mutable std::mutex mutex;
+
+    unsigned bandHeight(unsigned band) const;
+
+    //Make sure a band has pixels to draw into (call with mutex held)
+    Image& open(unsigned band);
+
+    //Compress a band's pixels and free them (call with mutex held)
+    void close(unsigned band);
+
+    //Uncompress a band into "out" (zeroes if it was never drawn)
+    void unpack(unsigned band, Image& out) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include <string.h>
+#include <algorithm>
+#include "utility/utility.h"
+#include "image/Image.h"
+
+namespace image
+{
+
+uint32_t packRGBA(const Color& color)
+{
+    return (uint32_t(color.r) << 24) | (uint32_t(color.g) << 16) |
+           (uint32_t(color.b) << 8)  |  uint32_t(color.a);
+}
+
+Color unpackRGBA(uint32_t pixel)
+{
+    return Color{ uint8_t(pixel >> 24), uint8_t(pixel >> 16),
+                  uint8_t(pixel >> 8),  uint8_t(pixel) };
+}
+
+unsigned bytesPerPixel(PixelFormat format)
+{
+    switch(format)
+    {
+    case PixelFormat::RGBA8:    return 4;
+    case PixelFormat::Indexed8: return 1;
+    case PixelFormat::Gray16:   return 2;
+    }
+
+    //Exception - should not happen
+    error("Invalid pixel format \"", int(format), "\"");
+    return 0;
+}
+
+/* ============================================================================
+ * Image */
+
+Image::Image()
+{
+
+}
+
+Image::Image(unsigned width, unsigned height, PixelFormat format)
+    : w(width), h(height), fmt(format)
+{
+    //Round each row up to the alignment, then over-allocate so the
+    //first row can be moved up to an aligned address as well
+    size_t rowBytes = size_t(w) * bytesPerPixel(fmt);
+    stride = (rowBytes + rowAlignment - 1) / rowAlignment * rowAlignment;
+
+    storage.reset(static_cast<uint8_t*>(calloc(stride * h + rowAlignment, 1)));
+    if(!storage) {
+        error("Cannot allocate ", w, "x", h, " image (", stride * h, " bytes)");
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.get());
+    size_t adjust = (rowAlignment - address % rowAlignment) % rowAlignment;
+    pixels = storage.get() + adjust;
+}
+
+Image::Image(Image&& other)
+{
+    *this = std::move(other);
+}
+
+Image& Image::operator=(Image&& other)
+{
+    /* The buffer itself does not move, so "pixels" stays valid.
+     * "other" is left as an empty image */
+    palette = std::move(other.palette);
+    storage = std::move(other.storage);
+    w = other.w;
+    h = other.h;
+    fmt = other.fmt;
+    stride = other.stride;
+    pixels = other.pixels;
+
+    other.w = other.h = 0;
+    other.stride = 0;
+    other.pixels = nullptr;
+
+    return *this;
+}
+
+unsigned Image::width() const
+{
+    return w;
+}
+
+unsigned Image::height() const
+{
+    return h;
+}
+
+PixelFormat Image::format() const
+{
+    return fmt;
+}
+
+bool Image::empty() const
+{
+    return pixels == nullptr || w == 0 || h == 0;
+}
+
+size_t Image::pitch() const
+{
+    return stride;
+}
+
+uint8_t* Image::row(unsigned y)
+{
+    return pixels + y * stride;
+}
+
+const uint8_t* Image::row(unsigned y) const
+{
+    return pixels + y * stride;
+}
+
+void Image::clear()
+{
+    if(!empty()) {
+        memset(pixels, 0, stride * h);
+    }
+}
+
+void Image::setPixel(int x, int y, const Color& color)
+{
+    if(inBounds(x, y)) {
+        uint8_t* p = row(y) + x*4;
+        p[0] = color.r;
+        p[1] = color.g;
+        p[2] = color.b;
+        p[3] = color.a;
+    }
+}
+
+Color Image::getPixel(int x, int y) const
+{
+    if(!inBounds(x, y)) {
+        return Color{};
+    }
+    const uint8_t* p = row(y) + x*4;
+    return Color{ p[0], p[1], p[2], p[3] };
+}
+
+void Image::setIndex(int x, int y, uint8_t index)
+{
+    if(inBounds(x, y)) {
+        row(y)[x] = index;
+    }
+}
+
+void Image::setGray(int x, int y, uint16_t value)
+{
+    if(inBounds(x, y)) {
+        reinterpret_cast<uint16_t*>(row(y))[x] = value;
+    }
+}
+
+void Image::fillRect(int x, int y, int rw, int rh, const Color& color)
+{
+    //Clip the rectangle to the image
+    int x0 = std::max(x, 0), x1 = std::min(x + rw, int(w));
+    int y0 = std::max(y, 0), y1 = std::min(y + rh, int(h));
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    //The common case is a 1x1 rectangle (scale of 1)
+    uint8_t rgba[4] = { color.r, color.g, color.b, color.a };
+    for(int py = y0; py != y1; ++py)
+    {
+        uint8_t* p = row(py) + x0*4;
+        for(int px = x0; px != x1; ++px, p += 4) {
+            memcpy(p, rgba, 4);
+        }
+    }
+}
+
+void Image::blit(const Image& src, int x, int y)
+{
+    if(src.format() != fmt) {
+        error("Cannot blit image of format ", int(src.format()), " onto ", int(fmt));
+    }
+
+    unsigned bpp = bytesPerPixel(fmt);
+
+    //Clip the source rectangle to this image
+    int x0 = std::max(x, 0), x1 = std::min(x + int(src.width()), int(w));
+    int y0 = std::max(y, 0), y1 = std::min(y + int(src.height()), int(h));
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    size_t rowBytes = size_t(x1 - x0) * bpp;
+    for(int py = y0; py != y1; ++py) {
+        memcpy(row(py) + x0*bpp, src.row(py - y) + (x0 - x)*bpp, rowBytes);
+    }
+}
+
+bool Image::inBounds(int x, int y) const
+{
+    return x >= 0 && y >= 0 && unsigned(x) < w && unsigned(y) < h;
+}
+
+}
@@ -0,0 +1,92 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+#include <vector>
+#include <memory>
+#include <stdlib.h>
+#include <stddef.h>
+#include "image/Color.h"
+
+/* Image is the renderer's own pixel buffer. It is a single allocation with
+ * rows padded out to a cache-line boundary, in one of a few pixel layouts.
+ * Drawers, the canvas and the PNG encoder all work on this directly */
+
+namespace image
+{
+
+//How pixels are laid out in a row
+enum class PixelFormat
+{
+    RGBA8 = 0,  //4 bytes per pixel; r, g, b, a
+    Indexed8,   //1 byte per pixel; index into Image::palette
+    Gray16      //2 bytes per pixel; native endian 16-bit luminance
+};
+
+//Number of bytes one pixel of "format" takes up
+unsigned bytesPerPixel(PixelFormat format);
+
+class Image
+{
+public:
+    //Every row starts on a multiple of this many bytes
+    static const size_t rowAlignment = 64;
+
+public:
+    Image();
+    Image(unsigned width, unsigned height, PixelFormat format = PixelFormat::RGBA8);
+
+    //Images can be big; only allow moving them around
+    Image(Image&& other);
+    Image& operator=(Image&& other);
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+
+    unsigned width() const;
+    unsigned height() const;
+    PixelFormat format() const;
+    bool empty() const;
+
+    //Bytes between the start of two rows. Always >= width * bytesPerPixel
+    size_t pitch() const;
+
+    //Pointer to the first pixel of row "y"
+    uint8_t* row(unsigned y);
+    const uint8_t* row(unsigned y) const;
+
+    //Set every byte of the image to zero (transparent / index 0 / black)
+    void clear();
+
+    /* Pixel access. The RGBA functions are only valid on RGBA8 images,
+     * setIndex on Indexed8 and setGray on Gray16. Out of bounds writes are ignored */
+    void setPixel(int x, int y, const Color& color);
+    Color getPixel(int x, int y) const;
+    void setIndex(int x, int y, uint8_t index);
+    void setGray(int x, int y, uint16_t value);
+
+    //Fill a rectangle with a color, clipped to the image bounds (RGBA8 only)
+    void fillRect(int x, int y, int w, int h, const Color& color);
+
+    //Copy all of "src" into this image with its top-left at x,y. Formats must match.
+    void blit(const Image& src, int x, int y);
+
+    //Colors for an Indexed8 image, index -> color
+    std::vector<Color> palette;
+
+private:
+    unsigned w = 0, h = 0;
+    PixelFormat fmt = PixelFormat::RGBA8;
+    size_t stride = 0;
+
+    /* "storage" owns the memory; "pixels" is the aligned start within it.
+     * It is calloc'd rather than a std::vector so big images come straight
+     * from the OS untouched: pages are only faulted in (and placed on a NUMA
+     * node) by whichever thread first draws into them */
+    struct FreeDeleter { void operator()(uint8_t* p) const { free(p); } };
+    std::unique_ptr<uint8_t, FreeDeleter> storage;
+    uint8_t* pixels = nullptr;
+
+    bool inBounds(int x, int y) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifdef HAVE_SDL2
+#include <string.h>
+#include "utility/utility.h"
+#include "image/SDLAdapter.h"
+
+namespace image
+{
+
+SDL_Surface* toSDLSurface(const Image& img)
+{
+    //Byte order r,g,b,a in memory, same as an RGBA8 Image row
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
+        0, img.width(), img.height(), 32, SDL_PIXELFORMAT_ABGR8888);
+
+    if(!surface) {
+        error("Cannot create SDL surface: ", SDL_GetError());
+    }
+
+    for(unsigned y = 0; y != img.height(); ++y)
+    {
+        uint8_t* dst = (uint8_t*)surface->pixels + y * surface->pitch;
+        const uint8_t* src = img.row(y);
+
+        switch(img.format())
+        {
+        case PixelFormat::RGBA8:
+            memcpy(dst, src, img.width() * 4);
+            break;
+        case PixelFormat::Indexed8:
+            for(unsigned x = 0; x != img.width(); ++x) {
+                Color c = src[x] < img.palette.size() ? img.palette[src[x]] : Color{};
+                memcpy(dst + x*4, &c, 4);
+            }
+            break;
+        case PixelFormat::Gray16:
+            for(unsigned x = 0; x != img.width(); ++x) {
+                uint8_t v = reinterpret_cast<const uint16_t*>(src)[x] >> 8;
+                Color c{ v, v, v, ALPHA_OPAQUE };
+                memcpy(dst + x*4, &c, 4);
+            }
+            break;
+        }
+    }
+
+    return surface;
+}
+
+SDL_Color toSDLColor(const Color& color)
+{
+    return SDL_Color{ color.r, color.g, color.b, color.a };
+}
+
+Color fromSDLColor(const SDL_Color& color)
+{
+    return Color{ color.r, color.g, color.b, color.a };
+}
+
+}
+
+#endif
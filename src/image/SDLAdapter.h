@@ -0,0 +1,26 @@
+#ifndef SDLADAPTER_H
+#define SDLADAPTER_H
+#ifdef HAVE_SDL2
+#include <SDL2/SDL.h>
+#include "image/Image.h"
+
+/* Optional bridge between Image and SDL, for viewer-style features.
+ * The renderer core does not use SDL; this is only compiled when SDL2
+ * was found at configure time (HAVE_SDL2) */
+
+namespace image
+{
+
+/* Create a new 32-bit RGBA SDL_Surface holding a copy of "img".
+ * Non-RGBA8 images are expanded (palette lookup / gray to RGB).
+ * The caller owns the returned surface (SDL_FreeSurface) */
+SDL_Surface* toSDLSurface(const Image& img);
+
+//Convert between SDL_Color and Color
+SDL_Color toSDLColor(const Color& color);
+Color fromSDLColor(const SDL_Color& color);
+
+}
+
+#endif
+#endif
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+ #include "utility/lodepng.h"
+#else
+ #include <png.h>
+#endif
+#include "utility/utility.h"
+#include "image/png.h"
+
+namespace image
+{
+
+#ifdef _WIN32
+
+void savePNG(unsigned width, unsigned height, PixelFormat format,
+             const std::vector<Color>& palette, const RowSource& rows,
+             const std::string& filename)
+{
+    //lodepng wants the whole image, tightly packed and big-endian
+    unsigned bpp = bytesPerPixel(format);
+    size_t rowBytes = size_t(width) * bpp;
+    std::vector<unsigned char> packed(rowBytes * height);
+    for(unsigned y = 0; y != height; ++y) {
+        memcpy(&packed[y * rowBytes], rows(y), rowBytes);
+    }
+
+    lodepng::State state;
+    LodePNGColorType colorType = LCT_RGBA;
+    unsigned bitDepth = 8;
+
+    switch(format)
+    {
+    case PixelFormat::RGBA8:
+        break;
+    case PixelFormat::Indexed8:
+        colorType = LCT_PALETTE;
+        for(const Color& c : palette) {
+            lodepng_palette_add(&state.info_png.color, c.r, c.g, c.b, c.a);
+            lodepng_palette_add(&state.info_raw, c.r, c.g, c.b, c.a);
+        }
+        state.encoder.auto_convert = 0;
+        break;
+    case PixelFormat::Gray16:
+        colorType = LCT_GREY;
+        bitDepth = 16;
+        for(size_t i = 0; i < packed.size(); i += 2) {
+            std::swap(packed[i], packed[i+1]);
+        }
+        break;
+    }
+
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = bitDepth;
+    state.info_png.color.colortype = colorType;
+    state.info_png.color.bitdepth = bitDepth;
+
+    std::vector<unsigned char> png;
+    unsigned result = lodepng::encode(png, packed, width, height, state);
+    if(result != 0) {
+        error("Could not encode PNG: ", lodepng_error_text(result));
+    }
+    if(lodepng::save_file(png, filename) != 0) {
+        error("Could not save PNG \"", filename, "\"");
+    }
+}
+
+#else
+
+/* The libpng calls themselves. libpng reports errors by longjmp'ing back
+ * into this function, which skips destructors; so nothing in here may own
+ * memory, and everything it needs is set up by the caller.
+ * Returns false on a libpng error */
+static bool writePNG(png_structp png, png_infop info, FILE* fp,
+                     unsigned width, unsigned height, int colorType, int bitDepth,
+                     png_color* palette, png_byte* paletteAlpha, int paletteSize,
+                     const RowSource& rows)
+{
+    if(setjmp(png_jmpbuf(png))) {
+        return false;
+    }
+
+    png_init_io(png, fp);
+    png_set_IHDR(png, info, width, height, bitDepth, colorType,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    if(paletteSize > 0) {
+        png_set_PLTE(png, info, palette, paletteSize);
+        png_set_tRNS(png, info, paletteAlpha, paletteSize, NULL);
+    }
+
+    png_write_info(png, info);
+
+    //Gray16 pixels are stored native endian; PNG is big endian
+    uint16_t endianTest = 1;
+    if(bitDepth == 16 && *(uint8_t*)&endianTest == 1) {
+        png_set_swap(png);
+    }
+
+    for(unsigned y = 0; y != height; ++y) {
+        png_write_row(png, (png_bytep)rows(y));
+    }
+
+    png_write_end(png, NULL);
+    return true;
+}
+
+void savePNG(unsigned width, unsigned height, PixelFormat format,
+             const std::vector<Color>& palette, const RowSource& rows,
+             const std::string& filename)
+{
+    int colorType = PNG_COLOR_TYPE_RGBA;
+    int bitDepth = 8;
+    std::vector<png_color> pngPalette;
+    std::vector<png_byte> paletteAlpha;
+
+    switch(format)
+    {
+    case PixelFormat::RGBA8:
+        break;
+    case PixelFormat::Indexed8:
+        colorType = PNG_COLOR_TYPE_PALETTE;
+        for(const Color& c : palette) {
+            pngPalette.push_back(png_color{c.r, c.g, c.b});
+            paletteAlpha.push_back(c.a);
+        }
+        break;
+    case PixelFormat::Gray16:
+        colorType = PNG_COLOR_TYPE_GRAY;
+        bitDepth = 16;
+        break;
+    }
+
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if(!fp) {
+        error("Could not open \"", filename, "\" for writing");
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    if(!png || !info) {
+        png_destroy_write_struct(&png, NULL);
+        fclose(fp);
+        error("Could not create PNG writer");
+    }
+
+    //"rows" may throw too (e.g. CompressedCanvas); clean up either way
+    bool written = false;
+    try {
+        written = writePNG(png, info, fp, width, height, colorType, bitDepth,
+                           pngPalette.data(), paletteAlpha.data(), pngPalette.size(), rows);
+    }
+    catch(...) {
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        throw;
+    }
+
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+    if(!written) {
+        error("Could not save PNG \"", filename, "\"");
+    }
+}
+
+#endif
+
+void savePNG(const Image& img, const std::string& filename)
+{
+    auto rows = [&img](unsigned y) { return img.row(y); };
+    savePNG(img.width(), img.height(), img.format(), img.palette, rows, filename);
+}
+
+}
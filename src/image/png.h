@@ -0,0 +1,31 @@
+#ifndef IMAGE_PNG_H
+#define IMAGE_PNG_H
+#include <string>
+#include <vector>
+#include <functional>
+#include "image/Image.h"
+
+/* PNG encoding for Image. On Windows, lodepng is used (no extra dependencies).
+ * On *nix, libpng is used, which writes directly from the image rows */
+
+namespace image
+{
+
+/* Save "img" as a PNG at "filename". RGBA8 is written as RGBA, Indexed8
+ * as a paletted PNG using img.palette, Gray16 as 16-bit grayscale.
+ * Throws on failure */
+void savePNG(const Image& img, const std::string& filename);
+
+//Returns a pointer to row "y" of an image being encoded. Rows are asked for in order
+typedef std::function<const uint8_t*(unsigned y)> RowSource;
+
+/* Same as above, for an image that isn't in memory all at once.
+ * Each row is width * bytesPerPixel(format) bytes, laid out like an Image row.
+ * With libpng, rows are written out as they come */
+void savePNG(unsigned width, unsigned height, PixelFormat format,
+             const std::vector<Color>& palette, const RowSource& rows,
+             const std::string& filename);
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include "utility/utility.h"
+#include "io/SimulatedStorage.h"
+
+namespace io
+{
+
+SimulatedStorage::Settings SimulatedStorage::Settings::parse(const std::string& spec)
+{
+    Settings settings;
+    for(const std::string& item : Split(spec, ","))
+    {
+        if(item.empty()) {
+            continue;
+        }
+        size_t equals = item.find('=');
+        std::string key = item.substr(0, equals);
+        std::string text = equals == std::string::npos ? "" : item.substr(equals + 1);
+        trim(key);
+        trim(text);
+
+        char* end = nullptr;
+        double value = strtod(text.c_str(), &end);
+        if(text.empty() || *end != '\0' || value < 0) {
+            error("Bad value \"", text, "\" for \"", key, "\" in I/O simulation settings");
+        }
+
+        if(key == "latency") {
+            settings.latencyMs = value;
+        } else if(key == "bandwidth") {
+            settings.bandwidthMBps = value;
+        } else if(key == "queue") {
+            settings.queueDepth = unsigned(value);
+        } else if(key == "cache") {
+            settings.cacheMB = value;
+        } else {
+            error("Unknown I/O simulation setting \"", key, "\". Valid: latency, bandwidth, queue, cache");
+        }
+    }
+    return settings;
+}
+
+SimulatedStorage::SimulatedStorage(std::unique_ptr<Storage> backing, const Settings& settings)
+    : backing(std::move(backing))
+    , settings(settings)
+    , bandwidth(settings.bandwidthMBps * 1024 * 1024)
+    , cacheCapacity(size_t(settings.cacheMB * 1024 * 1024 / pageBytes))
+{
+    if(settings.queueDepth > 0) {
+        queue = std::make_unique<background::WorkerGate>(settings.queueDepth);
+    }
+}
+
+uint64_t SimulatedStorage::fileSize(const std::string& path)
+{
+    //Metadata is assumed to be cached
+    return knownSize(path);
+}
+
+size_t SimulatedStorage::read(const std::string& path, uint64_t offset, size_t length, char* dest)
+{
+    //Only what's in the file costs anything, as with a real device
+    uint64_t size = knownSize(path);
+    length = offset < size ? std::min<uint64_t>(length, size - offset) : 0;
+
+    requests++;
+    bytesRead += length;
+
+    uint64_t missed = touchPages(path, offset, length);
+    if(missed > 0)
+    {
+        misses++;
+        bytesMissed += missed;
+
+        //Wait for a slot in the queue, then for the device
+        auto start = std::chrono::steady_clock::now();
+        background::WorkerGate::Pass pass(queue.get());
+        if(settings.latencyMs > 0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(settings.latencyMs));
+        }
+        bandwidth.acquire(missed);
+        waitedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return backing->read(path, offset, length, dest);
+}
+
+void SimulatedStorage::dropCaches(const std::string& path)
+{
+    backing->dropCaches(path);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    fileSizes.erase(path);
+    auto file = fileNumbers.find(path);
+    if(file == fileNumbers.end()) {
+        return;
+    }
+
+    for(auto it = lru.begin(); it != lru.end(); ) {
+        if(*it >> 40 == file->second) {
+            cached.erase(*it);
+            it = lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SimulatedStorage::logStats() const
+{
+    log("Simulated I/O: ", requests.load(), " reads (", misses.load(), " missed the cache), ",
+        bytesMissed / (1024*1024), " of ", bytesRead / (1024*1024), " MB from the device, ",
+        waitedNs / 1000000, " ms spent waiting across threads");
+}
+
+uint64_t SimulatedStorage::knownSize(const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = fileSizes.find(path);
+        if(it != fileSizes.end()) {
+            return it->second;
+        }
+    }
+
+    //Ask outside the lock; threads racing on the same new file get the same answer
+    uint64_t size = backing->fileSize(path);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    fileSizes[path] = size;
+    return size;
+}
+
+uint64_t SimulatedStorage::touchPages(const std::string& path, uint64_t offset, size_t length)
+{
+    if(length == 0) {
+        return 0;
+    }
+    uint64_t first = offset / pageBytes;
+    uint64_t last = (offset + length - 1) / pageBytes;
+    if(cacheCapacity == 0) {
+        return length;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    //Files are numbered as they're first seen; the page number goes in the low 40 bits
+    auto number = fileNumbers.emplace(path, fileNumbers.size()).first->second;
+
+    uint64_t missedPages = 0;
+    for(uint64_t page = first; page <= last; ++page)
+    {
+        uint64_t key = number << 40 | page;
+        auto it = cached.find(key);
+        if(it != cached.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            continue;
+        }
+
+        missedPages++;
+        lru.push_front(key);
+        cached[key] = lru.begin();
+        if(cached.size() > cacheCapacity) {
+            cached.erase(lru.back());
+            lru.pop_back();
+        }
+    }
+
+    //Partly cached reads only pay for the pages they miss
+    return std::min<uint64_t>(length, missedPages * pageBytes);
+}
+
+}
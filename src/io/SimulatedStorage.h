@@ -0,0 +1,84 @@
+#ifndef IO_SIMULATEDSTORAGE_H
+#define IO_SIMULATEDSTORAGE_H
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include "io/Storage.h"
+#include "utility/background.h"
+
+/* SimulatedStorage makes another Storage (usually the real files) behave
+ * like slower storage, for benchmarks that would otherwise only ever hit
+ * the page cache. Data still comes from the wrapped storage; only timing
+ * is simulated:
+ *
+ * - every request that misses the simulated cache waits "latency"
+ * - misses share a bandwidth cap, in bytes per second
+ * - at most "queueDepth" requests are in flight; more wait their turn
+ * - a page cache of "cacheBytes" (LRU, 4 KB pages) serves repeat reads
+ *   for free. Reads are cut off at the end of the file, so bytes past it
+ *   cost nothing; file sizes are looked up once per file and remembered.
+ *   dropCaches() empties it of a file, and passes the call on
+ *   to the wrapped storage; short of that, the wrapped storage's own cache
+ *   is left alone, so real reads stay fast and only simulated timing is measured
+ *
+ * Settings are given as a spec such as "latency=8,bandwidth=100,queue=4,cache=256",
+ * with latency in ms, bandwidth in MB/s and cache in MB. Anything left out
+ * (or 0) is unlimited, except the cache, which is off */
+
+namespace io
+{
+
+class SimulatedStorage : public Storage
+{
+public:
+    struct Settings
+    {
+        double latencyMs = 0;
+        double bandwidthMBps = 0;
+        unsigned queueDepth = 0;
+        double cacheMB = 0;
+
+        //Parse a spec as above. Throws on unknown keys or bad numbers
+        static Settings parse(const std::string& spec);
+    };
+
+public:
+    SimulatedStorage(std::unique_ptr<Storage> backing, const Settings& settings);
+
+    uint64_t fileSize(const std::string& path) override;
+    size_t read(const std::string& path, uint64_t offset, size_t length, char* dest) override;
+    void dropCaches(const std::string& path) override;
+    void logStats() const override;
+
+private:
+    static const uint64_t pageBytes = 4096;
+
+    std::unique_ptr<Storage> backing;
+    Settings settings;
+
+    background::RateLimiter bandwidth;
+    std::unique_ptr<background::WorkerGate> queue;
+
+    //LRU of cached pages, keyed by file number and page number,
+    //and the sizes of files read so far
+    std::mutex cacheMutex;
+    std::unordered_map<std::string, uint64_t> fileNumbers;
+    std::unordered_map<std::string, uint64_t> fileSizes;
+    std::list<uint64_t> lru;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> cached;
+    size_t cacheCapacity;
+
+    std::atomic<uint64_t> requests{0}, misses{0}, bytesRead{0}, bytesMissed{0};
+    std::atomic<uint64_t> waitedNs{0};
+
+    //Size of a file, asking the wrapped storage only the first time
+    uint64_t knownSize(const std::string& path);
+
+    /* Look up the pages of a read in the cache, inserting any missing ones.
+     * Returns how many bytes of the read weren't cached */
+    uint64_t touchPages(const std::string& path, uint64_t offset, size_t length);
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <algorithm>
+#ifndef _WIN32
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+#include "utility/utility.h"
+#include "io/Storage.h"
+
+namespace io
+{
+
+std::string Storage::readAll(const std::string& path, size_t pieceSize)
+{
+    std::string content(fileSize(path), '\0');
+    size_t offset = 0;
+    while(offset < content.size()) {
+        size_t length = std::min(pieceSize, content.size() - offset);
+        size_t got = read(path, offset, length, &content[offset]);
+        if(got == 0) {
+            break;
+        }
+        offset += got;
+    }
+    content.resize(offset);
+    return content;
+}
+
+/* FileStorage
+ * ========================================================================= */
+
+uint64_t FileStorage::fileSize(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) {
+        error("Could not open \"", path, "\"");
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size > 0 ? uint64_t(size) : 0;
+}
+
+size_t FileStorage::read(const std::string& path, uint64_t offset, size_t length, char* dest)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        error("Could not open \"", path, "\"");
+    }
+    size_t done = 0;
+    while(done < length) {
+        ssize_t got = pread(fd, dest + done, length - done, offset + done);
+        if(got <= 0) {
+            break;
+        }
+        done += got;
+    }
+    close(fd);
+    return done;
+#else
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) {
+        error("Could not open \"", path, "\"");
+    }
+    _fseeki64(file, offset, SEEK_SET);
+    size_t done = fread(dest, 1, length, file);
+    fclose(file);
+    return done;
+#endif
+}
+
+void FileStorage::dropCaches(const std::string& path)
+{
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+/* Current storage
+ * ========================================================================= */
+
+namespace
+{
+
+std::unique_ptr<Storage>& current()
+{
+    static std::unique_ptr<Storage> backend(new FileStorage());
+    return backend;
+}
+
+}
+
+Storage& storage()
+{
+    return *current();
+}
+
+void setStorage(std::unique_ptr<Storage> backend)
+{
+    current() = std::move(backend);
+}
+
+}
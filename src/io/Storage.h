@@ -0,0 +1,58 @@
+#ifndef IO_STORAGE_H
+#define IO_STORAGE_H
+#include <string>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Storage is where region files are read from. Everything that reads world
+ * data (RegionFile, and so RegionFileWorld) goes through io::storage(),
+ * so the backend can be swapped out: FileStorage reads real files, and
+ * SimulatedStorage (see SimulatedStorage.h) makes them behave like slow,
+ * cold storage for benchmarking */
+
+namespace io
+{
+
+class Storage
+{
+public:
+    virtual ~Storage() = default;
+
+    //Size of the file at "path" in bytes. Throws if it can't be opened
+    virtual uint64_t fileSize(const std::string& path) = 0;
+
+    /* Read up to "length" bytes at "offset" of "path" into "dest". Returns
+     * the number of bytes read, fewer at the end of the file. Thread safe.
+     * Throws if the file can't be opened */
+    virtual size_t read(const std::string& path, uint64_t offset, size_t length, char* dest) = 0;
+
+    //Forget anything cached of the file at "path", so it's read cold next time
+    virtual void dropCaches(const std::string& path) = 0;
+
+    //Log what reading has cost so far, if the backend keeps track
+    virtual void logStats() const { }
+
+    //Read a whole file, "pieceSize" bytes per read
+    std::string readAll(const std::string& path, size_t pieceSize = 1024 * 1024);
+};
+
+/* Plain files on disk. Dropping caches asks the OS to evict the file's
+ * pages (posix_fadvise, where available); dirty pages can't be dropped */
+class FileStorage : public Storage
+{
+public:
+    uint64_t fileSize(const std::string& path) override;
+    size_t read(const std::string& path, uint64_t offset, size_t length, char* dest) override;
+    void dropCaches(const std::string& path) override;
+};
+
+//The storage in use; a FileStorage unless setStorage was called
+Storage& storage();
+
+//Use "backend" from now on. Set this up before loading any world
+void setStorage(std::unique_ptr<Storage> backend);
+
+}
+
+#endif
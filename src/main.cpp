@@ -1,23 +1,39 @@
 #include <iostream>
 #include "draw/draw.h"
+#include "anvil/RegionCompactor.h"
+#include "anvil/WorldSampler.h"
 #include "utility/arguments.h"
 #include "utility/utility.h"
+#include "utility/background.h"
+#include "io/Storage.h"
+#include "io/SimulatedStorage.h"
 
 static const char USAGE[] =
 R"(Pwnsian Cartographer, Minecraft World Renderer
 
 Usage:
+    PwnsianCartographer compact <world> [-o --output=<file>] [--zlib-level=<n>]
+        [--simulate-io=<spec>] [--drop-caches]
+    PwnsianCartographer stats <world> [--sample=<fraction>] [--seed=<n>] [-t --threads=<n>] [-o --output=<file>]
+        [--simulate-io=<spec>] [--drop-caches]
     PwnsianCartographer <world> <render-type>
         [-g | --gridlines]
         [-i --items-zip=<filename>]
         [-t --threads=<n>]
         [-s --scale=<amount>]
         [-o --output=<file>]
+        [-r --rules=<file>]
+        [--shared-cache=<name>]
+        [--numa] [--huge-pages]
+        [--chunk-timeout=<ms>] [--max-chunk-kb=<kb>] [--retry-quarantined]
+        [--compress-canvas] [--tile-output=<dir>]
+        [--background] [--max-read-mb=<mb>] [--pressure-limit=<pct>]
+        [--simulate-io=<spec>] [--drop-caches]
     PwnsianCartographer <world> (--config-file=<file>)
     PwnsianCartographer ( -h | --help )
 
 Options:
-    render-type             Output render type. (normal, height, shaded)
+    render-type             Output render type. (normal, height, shaded, custom, data)
     -h --help               Show this screen.
     -g --gridlines          Add region-sized gridlines to output
     -c --config-file <file> Use a configuraiton file for all options
@@ -25,6 +41,36 @@ Options:
     -s --scale <amount>     Scale output. 1x, 2x, ... [default: 1]
     -t --threads <n>        Limit number of rendering threads; 0 for #CPU Cores [default: 0]
     -o --output <file>      Place output image in file instead of in "."
+                            (compact: write regions to this folder instead of in place;
+                             stats: also save the statistics as JSON)
+    -r --rules <file>       Color rules file for the custom render type
+    --shared-cache <name>   Share decoded chunks with other renders through the
+                            shared memory segment <name>
+    --numa                  Pin workers to NUMA nodes, each drawing a band of the
+                            world into canvas memory local to that node, and
+                            report cross-node page allocations (Linux numastat)
+    --huge-pages            Back the canvas with transparent huge pages
+    --chunk-timeout <ms>    Skip chunks that take longer than this to load; 0 for no limit [default: 10000]
+    --max-chunk-kb <kb>     Skip chunks bigger than this in the region file; 0 for no limit [default: 0]
+    --retry-quarantined     Retry skipped chunks on one thread, without limits, after rendering
+    --compress-canvas       Keep finished rows of the image compressed in memory,
+                            for renders too big to hold uncompressed
+    --tile-output <dir>     Write one 512x512 (times scale) PNG per region into <dir>
+                            instead of a single image
+    --background            Render at idle CPU and I/O priority, and use fewer workers
+                            while the machine is under CPU, I/O or memory pressure
+    --max-read-mb <mb>      Read region files at most this many MB per second; 0 for
+                            no limit [default: 0]
+    --pressure-limit <pct>  With --background, throttle when the 10s average stall
+                            time (Linux PSI) goes over this percent [default: 10]
+    --zlib-level <n>        Recompress chunks at this zlib level (0-9) when compacting;
+                            -1 keeps them as they are [default: -1]
+    --sample <fraction>     Fraction of chunks, picked at random, to estimate statistics
+                            from [default: 0.01]
+    --seed <n>              Seed for picking the sample; 0 for a random one [default: 0]
+    --simulate-io <spec>    Read regions as if from slower storage, for benchmarking, e.g.
+                            "latency=8,bandwidth=100,queue=4,cache=256" (ms, MB/s, MB)
+    --drop-caches           Evict the world's region files from the file cache first
 )";
 
 int main(int argc, char** argv)
@@ -33,10 +79,54 @@ int main(int argc, char** argv)
     {
         arguments::Args args(USAGE, argc, argv);
 
-        auto drawer = draw::createDrawer(args.requestedDrawer);
-        SDL_Surface* render = drawer->renderWorld(args.worldName, args);
+        //Before any region is read or thread started, so everything inherits it
+        if(args.background) {
+            background::lowerPriority();
+        }
+        background::setReadLimit(size_t(args.maxReadMB) * 1024 * 1024);
 
-        draw::saveSurfacePNG(render, args.outputFilename);
+        //Storage to read regions from, also before anything is read
+        if(!args.simulateIO.empty()) {
+            auto settings = io::SimulatedStorage::Settings::parse(args.simulateIO);
+            io::setStorage(std::make_unique<io::SimulatedStorage>(std::make_unique<io::FileStorage>(), settings));
+        }
+        if(args.dropCaches) {
+            for(auto& file : RegionFileWorld::findRegionFiles(args.worldName)) {
+                io::storage().dropCaches(file.second);
+            }
+        }
+
+        int result = 0;
+        if(args.stats) {
+            WorldSampler sampler(args.sampleFraction, args.numThreads, args.sampleSeed);
+            auto results = sampler.sample(args.worldName);
+            WorldSampler::print(results);
+            if(!args.outputFilename.empty()) {
+                WorldSampler::saveJson(results, args.outputFilename);
+            }
+        } else if(args.compact) {
+            RegionCompactor compactor(args.zlibLevel);
+            result = compactor.compactWorld(args.worldName, args.outputFilename) ? 0 : 1;
+        } else {
+            auto drawer = draw::createDrawer(args.requestedDrawer);
+
+            if(!args.tileOutputDir.empty()) {
+                result = drawer->renderTiles(args.worldName, args) ? 0 : 1;
+            } else if(args.compressCanvas) {
+                auto render = drawer->renderWorldCompressed(args.worldName, args);
+                result = draw::saveImagePNG(*render, args.outputFilename) ? 0 : 1;
+            } else {
+                image::Image render = drawer->renderWorld(args.worldName, args);
+                result = draw::saveImagePNG(render, args.outputFilename) ? 0 : 1;
+            }
+
+            if(result == 0) {
+                drawer->saveCompanionFiles(args);
+            }
+        }
+
+        io::storage().logStats();
+        return result;
     }
     catch(std::exception& ex) {
         log("Something Happened: ", ex.what());
@@ -1,8 +1,9 @@
 #include <iostream>
-#include <SDL2/SDL.h>
+#include <thread>
 #include "draw/draw.h"
 #include "config.h"
 #include "utility/utility.h"
+#include "utility/numautil.h"
 #include "utility/arguments.h"
 
 namespace arguments
@@ -15,9 +16,24 @@ Args::Args(const std::string& USAGE, int argc, char** argv)
     //<world> is the only required command line arugment
     worldName = args["<world>"].asString();
 
+    //Compacting takes its own few options
+    compact = args["compact"].asBool();
+    stats = args["stats"].asBool();
+
+    //Storage options go with any command
+    dropCaches = args["--drop-caches"].asBool();
+    auto& simulateArg = args["--simulate-io"];
+    if(simulateArg) {
+        simulateIO = simulateArg.asString();
+    }
+
     //Prase. If the config file is specified, load from that instead
     auto& configOption = args["--config-file"];
-    if(configOption) {
+    if(compact) {
+        fromDocOptCompact(args);
+    } else if(stats) {
+        fromDocOptStats(args);
+    } else if(configOption) {
         fromConfigFile(configOption.asString());
     } else {
         fromDocOpt(args);
@@ -31,7 +47,16 @@ void Args::fromDocOpt(std::map<std::string, docopt::value>& args)
 {
     numThreads = args["--threads"].asLong();
     gridlines = args["--gridlines"].asBool();
+    numa = args["--numa"].asBool();
+    hugePages = args["--huge-pages"].asBool();
     scale = args["--scale"].asLong();
+    chunkTimeoutMs = args["--chunk-timeout"].asLong();
+    maxChunkKB = args["--max-chunk-kb"].asLong();
+    retryQuarantined = args["--retry-quarantined"].asBool();
+    compressCanvas = args["--compress-canvas"].asBool();
+    background = args["--background"].asBool();
+    maxReadMB = args["--max-read-mb"].asLong();
+    pressureLimit = std::stod(args["--pressure-limit"].asString());
     itemZipFilename = args["--items-zip"].asString();
 
     //User choses drawer type
@@ -44,6 +69,45 @@ void Args::fromDocOpt(std::map<std::string, docopt::value>& args)
     if(outputArg) {
         outputFilename = outputArg.asString();
     }
+
+    auto& rulesArg = args["--rules"];
+    if(rulesArg) {
+        rulesFilename = rulesArg.asString();
+    }
+
+    auto& tileArg = args["--tile-output"];
+    if(tileArg) {
+        tileOutputDir = tileArg.asString();
+    }
+
+    auto& cacheArg = args["--shared-cache"];
+    if(cacheArg) {
+        sharedCacheName = cacheArg.asString();
+    }
+}
+
+void Args::fromDocOptCompact(std::map<std::string, docopt::value>& args)
+{
+    zlibLevel = args["--zlib-level"].asLong();
+
+    //Without an output folder, regions are compacted in place
+    auto& outputArg = args["--output"];
+    if(outputArg) {
+        outputFilename = outputArg.asString();
+    }
+}
+
+void Args::fromDocOptStats(std::map<std::string, docopt::value>& args)
+{
+    sampleFraction = std::stod(args["--sample"].asString());
+    sampleSeed = std::stoul(args["--seed"].asString());
+    numThreads = args["--threads"].asLong();
+
+    //Statistics are only saved as JSON if asked to
+    auto& outputArg = args["--output"];
+    if(outputArg) {
+        outputFilename = outputArg.asString();
+    }
 }
 
 void Args::fromConfigFile(const std::string& configFilename)
@@ -53,17 +117,60 @@ void Args::fromConfigFile(const std::string& configFilename)
 
     numThreads = config.GetInt("threads");
     gridlines = config.GetInt("gridlines");
+    numa = config.GetInt("numa");
+    hugePages = config.GetInt("huge-pages");
     scale = config.GetInt("scale");
+    chunkTimeoutMs = config.GetInt("chunk-timeout");
+    maxChunkKB = config.GetInt("max-chunk-kb");
+    retryQuarantined = config.GetInt("retry-quarantined");
+    compressCanvas = config.GetInt("compress-canvas");
+    background = config.GetInt("background");
+    maxReadMB = config.GetInt("max-read-mb");
+    pressureLimit = config.GetFloat("pressure-limit");
+    if(pressureLimit == 0) { //Missing from older config files
+        pressureLimit = 10;
+    }
     itemZipFilename = config.GetString("items-zip");
     outputFilename = config.GetString("output");
-    std::string renderType = config.GetString("render-type");
-    requestedDrawer = draw::getDrawerType(renderType); //Also validates type here
+    sharedCacheName = config.GetString("shared-cache");
+    rulesFilename = config.GetString("rules");
+    tileOutputDir = config.GetString("tile-output");
+    simulateIO = config.GetString("simulate-io");
+    dropCaches = config.GetInt("drop-caches");
+    renderTypeStr = config.GetString("render-type");
+    requestedDrawer = draw::getDrawerType(renderTypeStr); //Also validates type here
 }
 
 void Args::validateArguments()
 {
+    if(compact) {
+        if(zlibLevel < -1 || zlibLevel > 9) {
+            error("zlib level must be from 0 to 9, or -1 to keep chunks as they are");
+        }
+        if(!outputFilename.empty() && !isDirectory(outputFilename)) {
+            error("Output folder \"", outputFilename, "\" does not exist");
+        }
+        return;
+    }
+    if(stats) {
+        if(sampleFraction <= 0 || sampleFraction > 1) {
+            error("Sample fraction must be above 0, and at most 1");
+        }
+        if(numThreads <= 0) {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return;
+    }
+
     if(numThreads <= 0) { //This is actually the default case
-        numThreads = SDL_GetCPUCount();
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if(numa && !numautil::available()) {
+        log("NUMA placement is not available; rendering without it");
+        numa = false;
+    }
+    if(background && (pressureLimit <= 0 || pressureLimit > 100)) {
+        error("Pressure limit must be a percentage between 0 and 100");
     }
     if(scale < 1) {
         scale = 1;
@@ -71,9 +178,22 @@ void Args::validateArguments()
     if(outputFilename.empty()) {
         outputFilename = removePath(worldName)+"-output-"+renderTypeStr+".png";
     }
+    if(!sharedCacheName.empty() && sharedCacheName[0] != '/') {
+        sharedCacheName = "/" + sharedCacheName;
+    }
+    if(!tileOutputDir.empty() && !isDirectory(tileOutputDir)) {
+        error("Tile output folder \"", tileOutputDir, "\" does not exist");
+    }
+    if(requestedDrawer == draw::DrawerType::Data && gridlines) {
+        log("Gridlines would overwrite data; rendering without them");
+        gridlines = false;
+    }
     if(isDirectory(outputFilename)) {
         error("Output file \"", outputFilename, "\" is a directory");
     }
+    if(requestedDrawer == draw::DrawerType::Custom && !fileExists(rulesFilename)) {
+        error("The custom render type needs a color rules file (--rules), could not find \"", rulesFilename, "\"");
+    }
     if(!fileExists(itemZipFilename)) {
         error("Could not find items archive \"", itemZipFilename, "\"");
     }
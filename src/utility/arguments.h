@@ -26,11 +26,30 @@ public:
 
     //Command line properties
     bool gridlines = false;
+    bool numa = false;
+    bool hugePages = false;
     unsigned numThreads = 0;
     unsigned scale = 1;
+    unsigned chunkTimeoutMs = 0;
+    unsigned maxChunkKB = 0;
+    bool retryQuarantined = false;
+    bool compressCanvas = false;
+    bool background = false;
+    unsigned maxReadMB = 0;
+    double pressureLimit = 10;
+    bool compact = false;
+    int zlibLevel = -1;
+    bool stats = false;
+    double sampleFraction = 0.01;
+    unsigned long sampleSeed = 0;
+    bool dropCaches = false;
+    std::string simulateIO;
     std::string worldName; 
     std::string itemZipFilename;
     std::string outputFilename;
+    std::string sharedCacheName;
+    std::string rulesFilename;
+    std::string tileOutputDir;
     draw::DrawerType requestedDrawer;
 
 private:
@@ -38,6 +57,8 @@ private:
 
 private:
     void fromDocOpt(std::map<std::string, docopt::value>& opt);
+    void fromDocOptCompact(std::map<std::string, docopt::value>& opt);
+    void fromDocOptStats(std::map<std::string, docopt::value>& opt);
     void fromConfigFile(const std::string& configFilename);
     void validateArguments();
 };
@@ -0,0 +1,234 @@
+#ifdef __linux__
+ #include <sched.h>
+ #include <unistd.h>
+ #include <sys/syscall.h>
+ #include <sys/resource.h>
+#endif
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "utility/utility.h"
+#include "utility/background.h"
+
+namespace
+{
+
+//Read cap; see throttleRead
+background::RateLimiter readLimiter;
+
+}
+
+namespace background
+{
+
+void lowerPriority()
+{
+#ifdef __linux__
+    //There's no glibc wrapper for ioprio_set. Class 3 is "idle"
+    const int IOPRIO_WHO_PROCESS = 1;
+    const int IOPRIO_CLASS_IDLE = 3;
+    const int IOPRIO_CLASS_SHIFT = 13;
+    if(syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        log("Could not set idle I/O priority");
+    }
+
+    //Nice and scheduling policy are per thread on Linux, and inherited by new threads
+    if(setpriority(PRIO_PROCESS, 0, 19) != 0) {
+        log("Could not lower CPU priority");
+    }
+    sched_param param = {};
+    if(sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+        log("Could not switch to idle scheduling");
+    }
+#else
+    log("Background priorities are only supported on Linux");
+#endif
+}
+
+void setReadLimit(size_t bytesPerSecond)
+{
+    readLimiter.setRate(bytesPerSecond);
+}
+
+void throttleRead(size_t bytes)
+{
+    readLimiter.acquire(bytes);
+}
+
+/* RateLimiter
+ * ========================================================================= */
+
+RateLimiter::RateLimiter(double perSecond)
+    : rate(perSecond)
+    , availableAt(Clock::now())
+{
+
+}
+
+void RateLimiter::setRate(double perSecond)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    rate = perSecond;
+    availableAt = Clock::now();
+}
+
+std::chrono::nanoseconds RateLimiter::acquire(double amount)
+{
+    Clock::time_point now = Clock::now(), wakeAt;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(rate <= 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        wakeAt = std::max(availableAt, now);
+        auto duration = std::chrono::duration<double>(amount / rate);
+        availableAt = wakeAt + std::chrono::duration_cast<Clock::duration>(duration);
+    }
+    std::this_thread::sleep_until(wakeAt);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(wakeAt - now);
+}
+
+/* WorkerGate
+ * ========================================================================= */
+
+WorkerGate::WorkerGate(unsigned limit)
+    : limit(std::max(1u, limit))
+{
+
+}
+
+void WorkerGate::enter()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    room.wait(lock, [this]() { return inside < limit; });
+    inside++;
+}
+
+void WorkerGate::leave()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inside--;
+    }
+    room.notify_one();
+}
+
+void WorkerGate::setLimit(unsigned limit)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->limit = std::max(1u, limit);
+    }
+    room.notify_all();
+}
+
+unsigned WorkerGate::getLimit() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit;
+}
+
+WorkerGate::Pass::Pass(WorkerGate* gate)
+    : gate(gate)
+{
+    if(gate) {
+        gate->enter();
+    }
+}
+
+WorkerGate::Pass::~Pass()
+{
+    if(gate) {
+        gate->leave();
+    }
+}
+
+/* PressureMonitor
+ * ========================================================================= */
+
+PressureMonitor::PressureMonitor(WorkerGate& gate, unsigned maxWorkers, double thresholdPercent)
+    : gate(gate)
+    , maxWorkers(std::max(1u, maxWorkers))
+    , threshold(thresholdPercent)
+    , available(readPressure() >= 0)
+    , minWorkers(this->maxWorkers)
+{
+    if(available) {
+        thread = std::thread(&PressureMonitor::run, this);
+    }
+}
+
+PressureMonitor::~PressureMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if(thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool PressureMonitor::isAvailable() const
+{
+    return available;
+}
+
+unsigned PressureMonitor::getMinWorkers() const
+{
+    return minWorkers;
+}
+
+unsigned PressureMonitor::getThrottleCount() const
+{
+    return throttleCount;
+}
+
+void PressureMonitor::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!wake.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping; }))
+    {
+        double pressure = readPressure();
+        if(pressure < 0) {
+            continue;
+        }
+
+        //Back off quickly, and come back slowly
+        unsigned workers = gate.getLimit();
+        if(pressure > threshold && workers > 1) {
+            workers /= 2;
+            throttleCount++;
+        } else if(pressure < threshold / 2 && workers < maxWorkers) {
+            workers++;
+        } else {
+            continue;
+        }
+
+        gate.setLimit(workers);
+        minWorkers = std::min<unsigned>(minWorkers, workers);
+    }
+}
+
+double PressureMonitor::readPressure()
+{
+    /* Each file has a line like
+     * "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345" */
+    double highest = -1;
+    for(const char* name : { "cpu", "io", "memory" })
+    {
+        std::ifstream file(std::string("/proc/pressure/") + name);
+        std::string line;
+        while(std::getline(file, line)) {
+            double avg10 = 0;
+            if(sscanf(line.c_str(), "some avg10=%lf", &avg10) == 1) {
+                highest = std::max(highest, avg10);
+            }
+        }
+    }
+    return highest;
+}
+
+}
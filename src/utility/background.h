@@ -0,0 +1,133 @@
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+/* Tools for rendering in the background, on a machine that has more
+ * important work to do (e.g. a game server). Everything here is best-effort:
+ * where the OS doesn't support something, it is a no-op.
+ *
+ * - lowerPriority() puts the process at idle CPU and I/O priority
+ * - throttleRead() keeps file reads under a bandwidth limit
+ * - A PressureMonitor watches Linux PSI (/proc/pressure) and shrinks how
+ *   many workers a WorkerGate lets through while the machine is stalling */
+
+namespace background
+{
+
+/* Idle I/O priority, the lowest nice level and SCHED_IDLE, for the calling
+ * thread and every thread started from it afterwards. Call before starting
+ * any workers. Logs what couldn't be set */
+void lowerPriority();
+
+/* Cap reads done through throttleRead to "bytesPerSecond" across all threads.
+ * 0 (the default) means no cap */
+void setReadLimit(size_t bytesPerSecond);
+
+//Account for "bytes" about to be read, sleeping long enough to stay under the cap
+void throttleRead(size_t bytes);
+
+/* Spaces out requests so that together they stay under a rate, e.g. bytes
+ * per second. Each request books the next stretch of time the rate allows
+ * it, and acquire() sleeps until that stretch starts. Thread safe */
+class RateLimiter
+{
+public:
+    //0 means no limit
+    RateLimiter(double perSecond = 0);
+    RateLimiter(const RateLimiter&) = delete;
+
+    void setRate(double perSecond);
+
+    //Book "amount" and sleep until it may go ahead. Returns the time slept
+    std::chrono::nanoseconds acquire(double amount);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::mutex mutex;
+    double rate;
+    Clock::time_point availableAt;
+};
+
+/* A gate that at most "limit" workers can be inside at once. The limit can
+ * be changed at any time; lowering it makes later arrivals wait, but
+ * doesn't interrupt anyone already inside */
+class WorkerGate
+{
+public:
+    WorkerGate(unsigned limit);
+    WorkerGate(const WorkerGate&) = delete;
+
+    //Wait for room, and go in
+    void enter();
+    //Leave, letting a waiting worker in
+    void leave();
+
+    void setLimit(unsigned limit);
+    unsigned getLimit() const;
+
+    //Scoped enter/leave; does nothing for a null gate
+    class Pass
+    {
+    public:
+        Pass(WorkerGate* gate);
+       ~Pass();
+        Pass(const Pass&) = delete;
+    private:
+        WorkerGate* gate;
+    };
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable room;
+    unsigned limit;
+    unsigned inside = 0;
+};
+
+/* Polls PSI every second from a thread of its own. When the 10 second
+ * average of any "some" stall (CPU, I/O or memory) goes over
+ * "thresholdPercent", the gate's limit is halved; once every stall is
+ * under half the threshold, it grows back by one, up to "maxWorkers".
+ * Without /proc/pressure, the gate is left alone */
+class PressureMonitor
+{
+public:
+    PressureMonitor(WorkerGate& gate, unsigned maxWorkers, double thresholdPercent);
+   ~PressureMonitor();
+    PressureMonitor(const PressureMonitor&) = delete;
+
+    //Was PSI readable at all?
+    bool isAvailable() const;
+
+    //Fewest workers allowed at any point, and how often the gate was shrunk
+    unsigned getMinWorkers() const;
+    unsigned getThrottleCount() const;
+
+private:
+    WorkerGate& gate;
+    unsigned maxWorkers;
+    double threshold;
+    bool available;
+
+    std::atomic<unsigned> minWorkers;
+    std::atomic<unsigned> throttleCount{0};
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    void run();
+
+    //Highest "some avg10" stall percentage of cpu, io and memory, or -1 if none
+    static double readPressure();
+};
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include "utility/utility.h"
+#include "utility/deadline.h"
+
+Deadline::Deadline()
+    : limited(false)
+    , limit(0)
+{
+
+}
+
+Deadline::Deadline(std::chrono::milliseconds limit)
+    : limited(true)
+    , limit(limit)
+    , end(Clock::now() + limit)
+{
+
+}
+
+bool Deadline::isLimited() const
+{
+    return limited;
+}
+
+bool Deadline::expired() const
+{
+    return limited && Clock::now() > end;
+}
+
+void Deadline::check(const char* what) const
+{
+    if(expired()) {
+        error(what, " took longer than ", limit.count(), " ms");
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+#include <chrono>
+
+/* A point in time some work has to be done by. Long-running code calls
+ * check() every so often, which throws once the time is up. This is how
+ * a single slow chunk is stopped from holding up a whole worker.
+ * A default constructed Deadline never expires. */
+
+class Deadline
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+public:
+    Deadline();
+    explicit Deadline(std::chrono::milliseconds limit);
+
+    //Is there a limit at all?
+    bool isLimited() const;
+
+    //Has the time run out? Always false without a limit
+    bool expired() const;
+
+    //Throw a std::runtime_error naming "what" if the time has run out
+    void check(const char* what) const;
+
+private:
+    bool limited;
+    std::chrono::milliseconds limit;
+    Clock::time_point end;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MORTON_H
+#define MORTON_H
+#include <stdint.h>
+
+/* Morton (Z-order) curve helpers. Walking a 2D grid in Morton order
+ * keeps consecutive cells close together in both X and Z, so work that
+ * is scheduled in that order touches nearby memory (and nearby image rows) */
+
+namespace morton
+{
+
+//Spread the lower 16 bits of "v" out to the even bits of the result
+inline uint32_t spreadBits(uint32_t v)
+{
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+//Inverse of spreadBits: gather the even bits of "v" into the lower 16 bits
+inline uint32_t compactBits(uint32_t v)
+{
+    v &= 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0F0F0F0F;
+    v = (v | (v >> 4)) & 0x00FF00FF;
+    v = (v | (v >> 8)) & 0x0000FFFF;
+    return v;
+}
+
+/* Position of x,z along the curve. x and z must be non-negative and
+ * below 65536, so offset negative coordinates (e.g. by the world minimum) first */
+inline uint32_t encode(uint32_t x, uint32_t z)
+{
+    return spreadBits(x) | (spreadBits(z) << 1);
+}
+
+//Get back the X and Z of a position along the curve
+inline uint32_t decodeX(uint32_t index)
+{
+    return compactBits(index);
+}
+
+inline uint32_t decodeZ(uint32_t index)
+{
+    return compactBits(index >> 1);
+}
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifdef HAVE_NUMA
+ #include <numa.h>
+#endif
+#ifdef __linux__
+ #include <sys/mman.h>
+ #include <unistd.h>
+ #include <dirent.h>
+#endif
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include "utility/numautil.h"
+
+namespace
+{
+
+/* Shrink [address, address+length) to the whole pages inside it.
+ * Returns false if there are none */
+bool pageAlign(void*& address, size_t& length)
+{
+#ifdef __linux__
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)address + page - 1) / page * page;
+    uintptr_t end = ((uintptr_t)address + length) / page * page;
+    if(end <= begin) {
+        return false;
+    }
+    address = (void*)begin;
+    length = end - begin;
+    return true;
+#else
+    (void)address;
+    (void)length;
+    return false;
+#endif
+}
+
+}
+
+namespace numautil
+{
+
+#ifdef HAVE_NUMA
+
+bool available()
+{
+    return numa_available() != -1;
+}
+
+std::vector<int> cpuNodes()
+{
+    std::vector<int> nodes;
+    if(available()) {
+        struct bitmask* cpus = numa_allocate_cpumask();
+        for(int node = 0; node <= numa_max_node(); ++node) {
+            if(numa_node_to_cpus(node, cpus) == 0 && numa_bitmask_weight(cpus) > 0) {
+                nodes.push_back(node);
+            }
+        }
+        numa_free_cpumask(cpus);
+    }
+    if(nodes.empty()) {
+        nodes.push_back(0);
+    }
+    return nodes;
+}
+
+void runOnNode(int node)
+{
+    if(available()) {
+        numa_run_on_node(node);
+        numa_set_preferred(node);
+    }
+}
+
+void bindToNode(void* address, size_t length, int node)
+{
+    if(available() && pageAlign(address, length)) {
+        numa_tonode_memory(address, length, node);
+    }
+}
+
+#else
+
+bool available()
+{
+    return false;
+}
+
+std::vector<int> cpuNodes()
+{
+    return {0};
+}
+
+void runOnNode(int node)
+{
+    (void)node;
+}
+
+void bindToNode(void* address, size_t length, int node)
+{
+    (void)address;
+    (void)length;
+    (void)node;
+}
+
+#endif
+
+void adviseHugePages(void* address, size_t length)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if(pageAlign(address, length)) {
+        madvise(address, length, MADV_HUGEPAGE);
+    }
+#else
+    (void)address;
+    (void)length;
+#endif
+}
+
+PageCounters readPageCounters()
+{
+    PageCounters counters;
+#ifdef __linux__
+    const std::string nodesPath = "/sys/devices/system/node";
+    DIR* dir = opendir(nodesPath.c_str());
+    if(!dir) {
+        return counters;
+    }
+
+    while(dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if(name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+           name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+
+        //Lines of "<counter> <pages>"
+        std::ifstream file(nodesPath + "/" + name + "/numastat");
+        std::string key;
+        uint64_t value;
+        while(file >> key >> value) {
+            if(key == "local_node") {
+                counters.localNode += value;
+                counters.available = true;
+            } else if(key == "other_node") {
+                counters.otherNode += value;
+            } else if(key == "numa_miss") {
+                counters.numaMiss += value;
+            }
+        }
+    }
+    closedir(dir);
+#endif
+    return counters;
+}
+
+}
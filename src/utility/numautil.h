@@ -0,0 +1,47 @@
+#ifndef NUMAUTIL_H
+#define NUMAUTIL_H
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Small wrapper over libnuma for placing threads and memory on NUMA nodes.
+ * When built without libnuma (HAVE_NUMA undefined) or on a machine without
+ * NUMA support, everything reports a single node 0 and placement is a no-op */
+
+namespace numautil
+{
+
+//Is NUMA placement possible on this machine?
+bool available();
+
+/* The NUMA nodes that have CPUs to run threads on, in ascending order.
+ * Memory-only nodes are left out. Always holds at least node 0 */
+std::vector<int> cpuNodes();
+
+//Restrict the calling thread to the CPUs of "node", and prefer its memory
+void runOnNode(int node);
+
+/* Place the pages of [address, address+length) on "node". Only whole pages
+ * inside the range are affected. Pages already touched are not moved,
+ * so do this before anything is written to the memory */
+void bindToNode(void* address, size_t length, int node);
+
+//Ask for transparent huge pages on the whole pages of a range (Linux only)
+void adviseHugePages(void* address, size_t length);
+
+/* The kernel's NUMA page allocation counters, summed over every node
+ * (/sys/devices/system/node/node<N>/numastat, Linux only). They're counted
+ * system-wide, so take the difference across a stretch of work.
+ * "available" is false where the counters can't be read */
+struct PageCounters
+{
+    bool available = false;
+    uint64_t localNode = 0;     //Pages allocated on the node of the CPU asking
+    uint64_t otherNode = 0;     //...and on another node than that CPU's
+    uint64_t numaMiss = 0;      //Pages that went to another node than the preferred one
+};
+PageCounters readPageCounters();
+
+}
+
+#endif
@@ -91,6 +91,8 @@ bool isDirectory(const std::string& filename)
  #define STAT stat
 #endif
     struct stat stats;
-    stat(filename.c_str(), &stats);
+    if(stat(filename.c_str(), &stats) != 0) {
+        return false;
+    }
     return S_ISDIR(stats.st_mode);
 }